@@ -0,0 +1,896 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Arcade host, thousands of independent games in one process. Every session
+ * is a state machine of the menu, the message boxes and a game, driven by one
+ * epoll loop and a timer wheel, without a thread or a process per player
+ */
+/* accept4, posix_openpt */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "tui.h"
+#include "engine.h"
+#include "autopilot.h"
+#include "scene.h"
+
+#define DEFAULT_SOCKET "/tmp/csnake-arcade.sock"
+#define DEFAULT_SESSIONS 4096
+/* Events taken from epoll at once */
+#define MAX_EVENTS 256
+/* Slots of the timer wheel, one per millisecond, a power of 2 */
+#define WHEEL_SLOTS 1024U
+/* Redraw the whole screen, for a terminal attached after it was drawn */
+#define REDRAW_KEY '\f'
+/* Keys a session queues for its next ticks, one turn is applied per tick */
+#define SESSION_TURNS 4
+
+/* Telnet commands, a TCP client in telnet mode is asked for character mode */
+#define TELNET_IAC 255
+#define TELNET_SB 250
+#define TELNET_SE 240
+#define TELNET_WILL 251
+
+/* What an epoll event is about, sessions are tagged with their index */
+enum { TAG_SESSION, TAG_TIMER, TAG_SIGNAL, TAG_LISTEN };
+
+/* States of a session, what the next key does */
+enum { STATE_FREE, STATE_MENU, STATE_BOX, STATE_PLAYING, STATE_CLOSED };
+
+/* Progress through a telnet command which is skipped */
+enum { TELNET_DATA, TELNET_COMMAND, TELNET_OPTION, TELNET_SUB, TELNET_SUB_IAC };
+
+/* Session struct, one terminal and the game played on it */
+typedef struct {
+	/* -1 while the slot is free */
+	int fd;
+	/* The slave side of a pty session, held open so that it stays up
+	 * between players, -1 for a socket
+	 */
+	int pty_fd;
+	unsigned char state;
+	/* State entered when the message box is confirmed */
+	unsigned char box_next;
+	unsigned char autopilot;
+	unsigned char telnet;
+	/* Whether the screen changed while the last frame was still being sent */
+	unsigned char dirty;
+	/* Whether epoll waits for the terminal to take more */
+	unsigned char waits_out;
+	int menu_opt;
+	/* Direction keys pressed since the last tick */
+	unsigned char turns[SESSION_TURNS];
+	unsigned char turn_num;
+	/* Only initialized while playing */
+	game_t game;
+	view_t view;
+	screen_t screen;
+	/* The unsent end of the last frame */
+	char *backlog;
+	size_t backlog_pos;
+	size_t backlog_len;
+	/* Timer wheel links, an index plus 1 or 0 for none */
+	uint32_t timer_prev;
+	uint32_t timer_next;
+	uint64_t deadline_ms;
+} session_t;
+
+static session_t *sessions;
+static unsigned int max_sessions = DEFAULT_SESSIONS;
+/* Free slots, linked by their timer_next */
+static uint32_t free_head;
+static int epoll_fd;
+static int timer_fd;
+
+static game_config_t board;
+static long game_speed_ms = GAME_SPEED_MS;
+static view_t board_view;
+static short screen_rows, screen_cols;
+static uint64_t fixed_seed;
+static int seed_is_fixed = 0;
+static int telnet_mode = 0;
+
+/* Every session renders into the same frame buffer, and every
+ * autopilot search runs on the same arrays, the loop runs one at a time
+ */
+static char *frame;
+static autopilot_t pilot;
+
+/* Sessions waiting for a tick, hashed by their deadline in milliseconds */
+static uint32_t wheel[WHEEL_SLOTS];
+static uint64_t wheel_ms;
+static unsigned int timer_num;
+static int timer_armed;
+
+/* Statistics */
+static unsigned long long sessions_served, games_played, steps, ticks;
+static unsigned long long late_ms_sum, late_ms_max;
+static unsigned int sessions_live, sessions_max;
+
+always_inline uint64_t event_tag(unsigned int tag, unsigned int id)
+{
+	return (uint64_t)tag << 32 | id;
+}
+
+always_inline uint64_t now_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000U + (uint64_t)now.tv_nsec / 1000000U;
+}
+
+/* Board sides out of range become 0, which the config check rejects */
+always_inline short parse_side(const char *restrict arg)
+{
+	long side = strtol(arg, NULL, 0);
+	return side > 0 && side <= SHRT_MAX ? (short)side : 0;
+}
+
+static void watch(int fd, uint32_t events, uint64_t tag)
+{
+	struct epoll_event event = { .events = events, .data.u64 = tag };
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		perror("FATAL->epoll");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Put a session on the wheel slot of its deadline */
+static void timer_insert(uint32_t id, uint64_t deadline_ms)
+{
+	session_t *session = &sessions[id];
+	uint32_t *slot = &wheel[deadline_ms & (WHEEL_SLOTS - 1)];
+
+	session->deadline_ms = deadline_ms;
+	session->timer_prev = 0;
+	session->timer_next = *slot;
+	if (*slot != 0)
+		sessions[*slot - 1].timer_prev = id + 1;
+	*slot = id + 1;
+	++timer_num;
+}
+
+static void timer_remove(uint32_t id)
+{
+	session_t *session = &sessions[id];
+
+	if (session->timer_prev != 0)
+		sessions[session->timer_prev - 1].timer_next = session->timer_next;
+	else
+		wheel[session->deadline_ms & (WHEEL_SLOTS - 1)] = session->timer_next;
+	if (session->timer_next != 0)
+		sessions[session->timer_next - 1].timer_prev = session->timer_prev;
+
+	session->timer_prev = session->timer_next = 0;
+	--timer_num;
+}
+
+/* The wheel timer only runs while a game is being played */
+static void timer_arm(void)
+{
+	int armed = timer_num > 0;
+	if (armed == timer_armed)
+		return;
+
+	struct itimerspec period = { { 0, 0 }, { 0, 0 } };
+	if (armed)
+		period.it_interval.tv_nsec = period.it_value.tv_nsec = 1000000L;
+	timerfd_settime(timer_fd, 0, &period, NULL);
+	timer_armed = armed;
+}
+
+/* Send bytes to a session, what the terminal does not take waits for EPOLLOUT
+ *
+ * Return:
+ * 0 on success, -1 if the session is gone
+ */
+static int session_write(uint32_t id, const char *restrict data, size_t len)
+{
+	session_t *session = &sessions[id];
+
+	if (session->backlog_len == 0) {
+		while (len > 0) {
+			ssize_t ret = write(session->fd, data, len);
+			if (ret > 0) {
+				data += ret;
+				len -= (size_t)ret;
+				continue;
+			}
+			if (ret == -1 && errno == EINTR)
+				continue;
+			if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			return -1;
+		}
+		if (len == 0)
+			return 0;
+	}
+
+	char *backlog = realloc(session->backlog, session->backlog_len + len);
+	if (backlog == NULL)
+		return -1;
+	memcpy(backlog + session->backlog_len, data, len);
+	session->backlog = backlog;
+	session->backlog_len += len;
+
+	if (!session->waits_out) {
+		struct epoll_event event = {
+			.events = EPOLLIN | EPOLLOUT,
+			.data.u64 = event_tag(TAG_SESSION, id)
+		};
+		epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->fd, &event);
+		session->waits_out = 1;
+	}
+	return 0;
+}
+
+/* Send the changes of the screen, they pile up on the screen instead of
+ * the backlog while the terminal is slow, so a session never holds more
+ * than one frame
+ */
+static int session_present(uint32_t id)
+{
+	session_t *session = &sessions[id];
+
+	if (session->backlog_len != 0) {
+		session->dirty = 1;
+		return 0;
+	}
+
+	session->dirty = 0;
+	size_t len = screen_render(&session->screen);
+	return len != 0 ? session_write(id, session->screen.out, len) : 0;
+}
+
+/* Clear the terminal and draw the whole screen again */
+static int session_redraw(uint32_t id)
+{
+	static const char clear[] = "\e[?25l\e[39;49m\e[1;1H\e[2J";
+	session_t *session = &sessions[id];
+
+	/* Nobody read what a pty got before this terminal attached */
+	if (session->pty_fd != -1) {
+		tcflush(session->pty_fd, TCIFLUSH);
+		session->backlog_pos = session->backlog_len = 0;
+	}
+
+	screen_reset(&session->screen);
+	if (session_write(id, clear, sizeof(clear) - 1) != 0)
+		return -1;
+	return session_present(id);
+}
+
+static void session_close(uint32_t id)
+{
+	static const char bye[] = "\e[39;49m\e[1;1H\e[2J\e[?25h";
+	session_t *session = &sessions[id];
+
+	if (session->state == STATE_PLAYING) {
+		timer_remove(id);
+		game_destory(&session->game);
+	}
+
+	/* Best effort, a terminal which is gone or full misses it */
+	if (session->backlog_len == 0)
+		write(session->fd, bye, sizeof(bye) - 1);
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->fd, NULL);
+	close(session->fd);
+	if (session->pty_fd != -1)
+		close(session->pty_fd);
+	screen_destory(&session->screen);
+	free(session->backlog);
+
+	*session = (session_t){ .fd = -1, .pty_fd = -1, .timer_next = free_head };
+	free_head = id + 1;
+	--sessions_live;
+}
+
+static void show_menu(uint32_t id)
+{
+	session_t *session = &sessions[id];
+
+	session->state = STATE_MENU;
+	session->menu_opt = OPT_START;
+	scene_menu(&session->screen, session->menu_opt);
+}
+
+/* Start a session on a connected terminal
+ *
+ * Return:
+ * The session index, or -1 if every slot is taken
+ */
+static int session_open(int fd, int pty_fd)
+{
+	if (free_head == 0)
+		return -1;
+
+	uint32_t id = free_head - 1;
+	session_t *session = &sessions[id];
+	free_head = session->timer_next;
+
+	*session = (session_t){
+		.fd = fd,
+		.pty_fd = pty_fd,
+		.telnet = TELNET_DATA,
+		.view = board_view
+	};
+	screen_init_shared(&session->screen, screen_rows, screen_cols, frame);
+	watch(fd, EPOLLIN, event_tag(TAG_SESSION, id));
+
+	++sessions_served;
+	if (++sessions_live > sessions_max)
+		sessions_max = sessions_live;
+
+	show_menu(id);
+	return (int)id;
+}
+
+/* Move the snake of a session one step, the game ends in the result box */
+static void session_step(uint32_t id, unsigned char input)
+{
+	session_t *session = &sessions[id];
+
+	if (session->autopilot)
+		input = autopilot_next(&pilot, &session->game);
+
+	game_step(&session->game, input);
+	scene_step(&session->screen, &session->view, &session->game);
+	++steps;
+
+	if (session->game.over_type != GAME_RUNNING) {
+		timer_remove(id);
+		scene_result(&session->screen, &session->view, &session->game);
+		game_destory(&session->game);
+		session->state = STATE_BOX;
+		session->box_next = STATE_MENU;
+	}
+}
+
+static void start_game(uint32_t id, int autopilot)
+{
+	session_t *session = &sessions[id];
+	uint64_t seed = seed_is_fixed ? fixed_seed :
+		(uint64_t)time(NULL) ^ games_played * 0x9E3779B97F4A7C15ULL;
+
+	game_init_config(&session->game, &board, seed);
+	scene_game(&session->screen, &session->view, &session->game);
+	session->state = STATE_PLAYING;
+	session->autopilot = (unsigned char)autopilot;
+	session->turn_num = 0;
+	timer_insert(id, now_ms() + (uint64_t)game_speed_ms);
+	++games_played;
+}
+
+/* One key of a session, what it does depends on the state
+ *
+ * Return:
+ * 0 on success, -1 if the session is closed
+ */
+static int session_key(uint32_t id, unsigned char key)
+{
+	session_t *session = &sessions[id];
+
+	if (key == REDRAW_KEY)
+		return 0;
+
+	switch (session->state) {
+		case STATE_MENU:
+			if (!scene_menu_key(&session->screen, &session->menu_opt, (char)key))
+				break;
+
+			switch (session->menu_opt) {
+				case OPT_START:
+				case OPT_AUTOPILOT:
+					start_game(id, session->menu_opt == OPT_AUTOPILOT);
+					break;
+				case OPT_HELP:
+					scene_help(&session->screen, &session->view);
+					session->state = STATE_BOX;
+					session->box_next = STATE_MENU;
+					break;
+				case OPT_EXIT:
+					scene_goodbye(&session->screen, &session->view);
+					session->state = STATE_BOX;
+					session->box_next = STATE_CLOSED;
+					break;
+			}
+			break;
+		case STATE_BOX:
+			if (key != CONFIRM_KEY)
+				break;
+
+			/* A pty goes back to the menu for the next player */
+			if (session->box_next == STATE_CLOSED && session->pty_fd == -1) {
+				session_close(id);
+				return -1;
+			}
+			show_menu(id);
+			break;
+		case STATE_PLAYING:
+			/* Turns wait for the next tick, so keys never move the deadlines */
+			if (!session->autopilot && session->turn_num < SESSION_TURNS &&
+					(key == UP_KEY || key == DOWN_KEY || key == LEFT_KEY || key == RIGHT_KEY))
+				session->turns[session->turn_num++] = key;
+			break;
+	}
+
+	return 0;
+}
+
+/* Telnet commands in the input are skipped, the rest are keys
+ *
+ * Return:
+ * 1 if the byte is a key, 0 otherwise
+ */
+always_inline int telnet_filter(session_t *restrict session, unsigned char byte)
+{
+	switch (session->telnet) {
+		case TELNET_DATA:
+			if (byte != TELNET_IAC || !telnet_mode)
+				return 1;
+			session->telnet = TELNET_COMMAND;
+			return 0;
+		case TELNET_COMMAND:
+			/* IAC IAC is a literal 255 */
+			if (byte == TELNET_IAC) {
+				session->telnet = TELNET_DATA;
+				return 1;
+			}
+			session->telnet = byte == TELNET_SB ? TELNET_SUB :
+				byte >= TELNET_WILL ? TELNET_OPTION : TELNET_DATA;
+			return 0;
+		case TELNET_OPTION:
+			session->telnet = TELNET_DATA;
+			return 0;
+		case TELNET_SUB:
+			if (byte == TELNET_IAC)
+				session->telnet = TELNET_SUB_IAC;
+			return 0;
+		default:
+			session->telnet = byte == TELNET_SE ? TELNET_DATA : TELNET_SUB;
+			return 0;
+	}
+}
+
+static void read_session(uint32_t id)
+{
+	session_t *session = &sessions[id];
+	unsigned char keys[256];
+	int redraw = 0;
+
+	while (1) {
+		ssize_t len = read(session->fd, keys, sizeof(keys));
+		if (len > 0) {
+			for (ssize_t i = 0; i < len; ++i) {
+				if (!telnet_filter(session, keys[i]))
+					continue;
+				redraw |= keys[i] == REDRAW_KEY;
+				if (session_key(id, keys[i]) != 0)
+					return;
+			}
+			continue;
+		}
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		session_close(id);
+		return;
+	}
+
+	if ((redraw ? session_redraw(id) : session_present(id)) != 0)
+		session_close(id);
+}
+
+/* Send the backlog, then the changes which piled up behind it */
+static void write_session(uint32_t id)
+{
+	session_t *session = &sessions[id];
+
+	while (session->backlog_pos < session->backlog_len) {
+		ssize_t len = write(session->fd, session->backlog + session->backlog_pos,
+			session->backlog_len - session->backlog_pos);
+		if (len > 0) {
+			session->backlog_pos += (size_t)len;
+			continue;
+		}
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+
+		session_close(id);
+		return;
+	}
+
+	free(session->backlog);
+	session->backlog = NULL;
+	session->backlog_pos = session->backlog_len = 0;
+
+	struct epoll_event event = { .events = EPOLLIN, .data.u64 = event_tag(TAG_SESSION, id) };
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->fd, &event);
+	session->waits_out = 0;
+
+	if (session->dirty && session_present(id) != 0)
+		session_close(id);
+}
+
+/* Take the first queued key which turns the snake of a session */
+always_inline unsigned char next_turn(session_t *restrict session)
+{
+	unsigned int i = 0;
+	while (i < session->turn_num && !game_can_turn(&session->game, session->turns[i]))
+		++i;
+
+	unsigned char turn = i < session->turn_num ? session->turns[i++] : 0;
+	memmove(session->turns, session->turns + i, session->turn_num - i);
+	session->turn_num = (unsigned char)(session->turn_num - i);
+	return turn;
+}
+
+/* Step every session whose deadline has passed, slot by slot up to now */
+static void run_wheel(void)
+{
+	uint64_t now = now_ms();
+	/* Every slot is looked at once at most, a long stall fires all of them */
+	uint64_t from = now - wheel_ms > WHEEL_SLOTS ? now - WHEEL_SLOTS + 1 : wheel_ms + 1;
+
+	for (uint64_t ms = from; ms <= now; ++ms) {
+		uint32_t next = wheel[ms & (WHEEL_SLOTS - 1)];
+		while (next != 0) {
+			uint32_t id = next - 1;
+			session_t *session = &sessions[id];
+			next = session->timer_next;
+			if (session->deadline_ms > ms)
+				continue;
+
+			/* Late ticks are dropped, the snakes never jump, and the next
+			 * deadline stays a whole number of periods after the first one
+			 */
+			uint64_t late = now - session->deadline_ms;
+			uint64_t deadline = session->deadline_ms +
+				(late / (uint64_t)game_speed_ms + 1) * (uint64_t)game_speed_ms;
+			late_ms_sum += late;
+			++ticks;
+			if (late > late_ms_max)
+				late_ms_max = late;
+
+			timer_remove(id);
+			timer_insert(id, deadline);
+			session_step(id, next_turn(session));
+			if (session_present(id) != 0)
+				session_close(id);
+		}
+	}
+
+	if (now > wheel_ms)
+		wheel_ms = now;
+}
+
+static void accept_sessions(int listen_fd)
+{
+	/* Ask a telnet client to let the server echo and to send every key at once */
+	static const unsigned char telnet_setup[] = {
+		TELNET_IAC, TELNET_WILL, 1, TELNET_IAC, TELNET_WILL, 3
+	};
+
+	while (1) {
+		int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd == -1)
+			return;
+
+		/* Frames are small and should leave at once */
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		int id = session_open(fd, -1);
+		if (id < 0) {
+			static const char full[] = "The arcade is full, try again later\r\n";
+			write(fd, full, sizeof(full) - 1);
+			close(fd);
+			continue;
+		}
+
+		int ret = 0;
+		if (telnet_mode)
+			ret = session_write((uint32_t)id, (const char *)telnet_setup, sizeof(telnet_setup));
+		if (ret != 0 || session_redraw((uint32_t)id) != 0)
+			session_close((uint32_t)id);
+	}
+}
+
+/* Open a pty which a player attaches a terminal to, in raw mode
+ *
+ * Return:
+ * 0 on success, -1 otherwise
+ */
+static int open_pty(void)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd == -1 || grantpt(fd) == -1 || unlockpt(fd) == -1)
+		return -1;
+
+	const char *name = ptsname(fd);
+	int pty_fd = name != NULL ? open(name, O_RDWR | O_NOCTTY | O_CLOEXEC) : -1;
+	struct termios config;
+	if (pty_fd == -1 || tcgetattr(pty_fd, &config) == -1)
+		return -1;
+	cfmakeraw(&config);
+	tcsetattr(pty_fd, TCSANOW, &config);
+
+	int id = session_open(fd, pty_fd);
+	if (id < 0)
+		return -1;
+
+	printf("Session %d on %s\n", id, name);
+	return session_redraw((uint32_t)id);
+}
+
+static int listen_unix(const char *restrict path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fputs("Arcade->FATAL: The socket path is too long!\n", stderr);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+			listen(fd, SOMAXCONN) == -1) {
+		perror("FATAL->Socket");
+		return -1;
+	}
+	return fd;
+}
+
+/* Any address, the players are on other machines */
+static int listen_tcp(unsigned short port)
+{
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 ||
+			bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+			listen(fd, SOMAXCONN) == -1) {
+		perror("FATAL->Socket");
+		return -1;
+	}
+	return fd;
+}
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-u|--unix path] [-p|--port port [--telnet]] [-t|--pty ptys]\n"
+		"          [-n|--sessions sessions] [-W|--width width] [-H|--height height]\n"
+		"          [--win win_size] [--speed speed_ms] [-s|--seed seed]\n"
+		"Every connection and pty plays its own game of the menu, Ctrl-L redraws the screen\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	enum { OPT_WIN = 256, OPT_SPEED, OPT_TELNET };
+	static const struct option long_options[] = {
+		{ "unix", required_argument, NULL, 'u' },
+		{ "port", required_argument, NULL, 'p' },
+		{ "telnet", no_argument, NULL, OPT_TELNET },
+		{ "pty", required_argument, NULL, 't' },
+		{ "sessions", required_argument, NULL, 'n' },
+		{ "width", required_argument, NULL, 'W' },
+		{ "height", required_argument, NULL, 'H' },
+		{ "win", required_argument, NULL, OPT_WIN },
+		{ "speed", required_argument, NULL, OPT_SPEED },
+		{ "seed", required_argument, NULL, 's' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *socket_path = DEFAULT_SOCKET;
+	long port = 0;
+	unsigned int pty_num = 0;
+	board = game_default_config;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "u:p:t:n:W:H:s:", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'u':
+				socket_path = optarg;
+				break;
+			case 'p':
+				port = strtol(optarg, NULL, 0);
+				break;
+			case OPT_TELNET:
+				telnet_mode = 1;
+				break;
+			case 't':
+				pty_num = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				max_sessions = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case 'W':
+				board.width = parse_side(optarg);
+				break;
+			case 'H':
+				board.height = parse_side(optarg);
+				break;
+			case OPT_WIN:
+				board.win_size = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case OPT_SPEED:
+				game_speed_ms = strtol(optarg, NULL, 0);
+				break;
+			case 's':
+				fixed_seed = strtoull(optarg, NULL, 0);
+				seed_is_fixed = 1;
+				break;
+			default:
+				print_usage(argv[0]);
+				return EXIT_USAGE;
+		}
+	}
+
+	if (port < 0 || port > 65535 || game_speed_ms <= 0 || max_sessions == 0 ||
+			pty_num > max_sessions) {
+		print_usage(argv[0]);
+		return EXIT_USAGE;
+	}
+
+	const char *error = game_config_error(&board);
+	if (error != NULL) {
+		fprintf(stderr, "Invalid board: %s\n", error);
+		return EXIT_USAGE;
+	}
+
+	/* The terminals of the players are assumed to be of the default size */
+	board_view.rows = board.height < TERMINAL_DEFAULT_ROWS ? board.height : TERMINAL_DEFAULT_ROWS;
+	board_view.cols = board.width < TERMINAL_DEFAULT_COLS ? board.width : TERMINAL_DEFAULT_COLS;
+	screen_rows = board_view.rows > MENU_HEIGHT ? board_view.rows : MENU_HEIGHT;
+	screen_cols = board_view.cols > MENU_WIDTH ? board_view.cols : MENU_WIDTH;
+
+	sessions = calloc(max_sessions, sizeof(session_t));
+	frame = malloc(SCREEN_OUT_SIZE(screen_rows, screen_cols));
+	if (sessions == NULL || frame == NULL) {
+		fputs("Arcade->FATAL: Could not allocate memory!\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (unsigned int i = max_sessions; i-- > 0;) {
+		sessions[i] = (session_t){ .fd = -1, .pty_fd = -1, .timer_next = free_head };
+		free_head = i + 1;
+	}
+	autopilot_init(&pilot);
+
+	if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		perror("FATAL->epoll");
+		return EXIT_FAILURE;
+	}
+
+	int unix_fd = listen_unix(socket_path);
+	int tcp_fd = port != 0 ? listen_tcp((unsigned short)port) : -1;
+	if (unix_fd == -1 || (port != 0 && tcp_fd == -1))
+		return EXIT_FILE_ERR;
+	watch(unix_fd, EPOLLIN, event_tag(TAG_LISTEN, (unsigned int)unix_fd));
+	if (tcp_fd != -1)
+		watch(tcp_fd, EPOLLIN, event_tag(TAG_LISTEN, (unsigned int)tcp_fd));
+
+	/* Signals end the loop instead of the process, so the socket is removed */
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (signal_fd == -1 || timer_fd == -1) {
+		perror("FATAL->Timer");
+		return EXIT_TIMER_ERR;
+	}
+	watch(signal_fd, EPOLLIN, event_tag(TAG_SIGNAL, 0));
+	watch(timer_fd, EPOLLIN, event_tag(TAG_TIMER, 0));
+	wheel_ms = now_ms();
+
+	printf("Serving %dx%d games to %u sessions on %s", board.width, board.height,
+		max_sessions, socket_path);
+	if (port != 0)
+		printf(" and port %ld%s", port, telnet_mode ? " (telnet)" : "");
+	putchar('\n');
+	for (unsigned int i = 0; i < pty_num; ++i) {
+		if (open_pty() != 0) {
+			perror("FATAL->pty");
+			return EXIT_FILE_ERR;
+		}
+	}
+	fflush(stdout);
+
+	struct epoll_event events[MAX_EVENTS];
+	int running = 1;
+	while (running) {
+		timer_arm();
+
+		int event_num = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (event_num == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("FATAL->epoll");
+			break;
+		}
+
+		for (int i = 0; i < event_num && running; ++i) {
+			unsigned int tag = (unsigned int)(events[i].data.u64 >> 32);
+			unsigned int id = (unsigned int)events[i].data.u64;
+
+			switch (tag) {
+				case TAG_LISTEN:
+					accept_sessions((int)id);
+					break;
+				case TAG_SIGNAL:
+					running = 0;
+					break;
+				case TAG_TIMER: {
+					uint64_t expirations;
+					if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+						run_wheel();
+					break;
+				}
+				default:
+					/* The session may have been closed by an earlier event */
+					if (sessions[id].fd == -1)
+						break;
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+						read_session(id);
+					if (sessions[id].fd != -1 && (events[i].events & EPOLLOUT))
+						write_session(id);
+			}
+		}
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("%llu sessions, %u at once, %llu games, %llu steps, late ticks %.2f ms mean %llu ms max\n"
+		"peak RSS %ld KB, %.1f KB per session\n",
+		sessions_served, sessions_max, games_played, steps,
+		ticks != 0 ? (double)late_ms_sum / ticks : 0.0, late_ms_max,
+		usage.ru_maxrss, sessions_max != 0 ? (double)usage.ru_maxrss / sessions_max : 0.0);
+
+	for (unsigned int id = 0; id < max_sessions; ++id) {
+		if (sessions[id].fd != -1)
+			session_close(id);
+	}
+	free(sessions);
+	free(frame);
+	autopilot_destory(&pilot);
+	close(unix_fd);
+	unlink(socket_path);
+	if (tcp_fd != -1)
+		close(tcp_fd);
+	close(timer_fd);
+	close(signal_fd);
+	close(epoll_fd);
+
+	return EXIT_CLEAN;
+}
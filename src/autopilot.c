@@ -0,0 +1,410 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "autopilot.h"
+
+enum { MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT, MOVE_NONE };
+
+static const unsigned char move_keys[4] = { UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY };
+static const short move_dy[4] = { -1, 1, 0, 0 };
+static const short move_dx[4] = { 0, 0, -1, 1 };
+
+always_inline uint32_t cell_index(const autopilot_t *restrict pilot, const cord_t *restrict cord)
+{
+	return (uint32_t)cord->y * (uint32_t)pilot->config.width + (uint32_t)cord->x;
+}
+
+always_inline int cell_blocked(const autopilot_t *restrict pilot,
+	const bitboard_t *restrict board, uint32_t cell)
+{
+	return bitboard_test(board, (short)(cell / pilot->config.width),
+		(short)(cell % pilot->config.width));
+}
+
+/* Allocate an array of one item per cell */
+always_inline void *cells_alloc(const game_config_t *restrict config, size_t item_size)
+{
+	void *cells = malloc((size_t)config->height * (size_t)config->width * item_size);
+	if (cells == NULL) {
+		fputs("Autopilot->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	return cells;
+}
+
+/* Index of the i-th segment from the tail of the snake followed by the path */
+always_inline uint32_t body_after_path(const autopilot_t *restrict pilot,
+	game_t *restrict game, size_t i)
+{
+	size_t len = game_snake_len(game);
+	if (i >= len)
+		return pilot->path[i - len];
+
+	cord_t node = game_snake_get(game, i);
+	return cell_index(pilot, &node);
+}
+
+/* Breadth first search until the target is seen, the target may be blocked */
+static int search(autopilot_t *restrict pilot, const bitboard_t *restrict board,
+	uint32_t from, uint32_t target)
+{
+	/* Bumping the stamp forgets the last search without clearing anything */
+	if (++pilot->search_stamp == 0) {
+		memset(pilot->stamps, 0,
+			sizeof(uint32_t) * (size_t)pilot->config.height * (size_t)pilot->config.width);
+		pilot->search_stamp = 1;
+	}
+
+	uint32_t stamp = pilot->search_stamp;
+	size_t front = 0, back = 0;
+
+	pilot->stamps[from] = stamp;
+	pilot->frontier[back++] = from;
+
+	while (front < back) {
+		uint32_t cell = pilot->frontier[front++];
+
+		for (unsigned char move = 0; move < 4; ++move) {
+			uint32_t next = cell + pilot->move_offsets[move];
+			if (pilot->stamps[next] == stamp)
+				continue;
+
+			if (next == target) {
+				pilot->stamps[next] = stamp;
+				pilot->moves[next] = move;
+				return 1;
+			}
+
+			if (cell_blocked(pilot, board, next))
+				continue;
+
+			pilot->stamps[next] = stamp;
+			pilot->moves[next] = move;
+			pilot->frontier[back++] = next;
+		}
+	}
+
+	return 0;
+}
+
+/* Walk the moves of the last search back from the target into path */
+static size_t trace_path(autopilot_t *restrict pilot, uint32_t from, uint32_t target)
+{
+	size_t len = 0;
+	for (uint32_t cell = target; cell != from; cell -= pilot->move_offsets[pilot->moves[cell]])
+		++len;
+
+	size_t i = len;
+	for (uint32_t cell = target; cell != from; cell -= pilot->move_offsets[pilot->moves[cell]])
+		pilot->path[--i] = cell;
+
+	return len;
+}
+
+/* Check whether the tail is still reachable after following the path
+ *
+ * Parameters:
+ * pilot: pointer to an autopilot holding a path
+ * game: pointer to a game
+ * path_len: number of cells in the path
+ * grows: 1 if the last cell of the path is the food, 0 otherwise
+ *
+ * Return:
+ * 1 if it is safe to take the path, 0 otherwise
+ */
+static int path_is_safe(autopilot_t *restrict pilot, game_t *restrict game,
+	size_t path_len, int grows)
+{
+	size_t len = game_snake_len(game);
+	if (grows && len + 1 == game->config.win_size)
+		return 1;
+
+	/* The first vacated cells of the snake and then of the path leave the board */
+	size_t vacated = path_len - grows;
+	bitboard_copy(&pilot->after, &game->blocked);
+	for (size_t i = 0; i < vacated && i < len; ++i) {
+		cord_t node = game_snake_get(game, i);
+		bitboard_clear(&pilot->after, node.y, node.x);
+	}
+	for (size_t i = vacated > len ? vacated - len : 0; i < path_len; ++i) {
+		uint32_t cell = pilot->path[i];
+		bitboard_set(&pilot->after, (short)(cell / pilot->config.width),
+			(short)(cell % pilot->config.width));
+	}
+
+	uint32_t tail = body_after_path(pilot, game, vacated);
+	return search(pilot, &pilot->after, pilot->path[path_len - 1], tail);
+}
+
+/* Direction to leave a cell by along a cycle of a rows x cols area, the first row
+ * leads back to the start and the columns are walked up and down.  With an odd
+ * number of columns the rows must be odd too, the last two columns are then
+ * walked in rows from the bottom up and the last cell of the first row is left out
+ */
+static unsigned char cycle_move(short r, short c, short rows, short cols)
+{
+	if (r == 0) {
+		if (c == 0)
+			return MOVE_DOWN;
+		return cols % 2 != 0 && c == cols - 1 ? MOVE_NONE : MOVE_LEFT;
+	}
+
+	if (cols % 2 != 0 && c >= cols - 2) {
+		if ((rows - 1 - r) % 2 == 0)
+			return c == cols - 2 ? MOVE_RIGHT : MOVE_UP;
+		return c == cols - 1 ? MOVE_LEFT : MOVE_UP;
+	}
+
+	if (c % 2 == 0)
+		return r == rows - 1 ? MOVE_RIGHT : MOVE_DOWN;
+	if (r > 1)
+		return MOVE_UP;
+	return c == cols - 1 ? MOVE_UP : MOVE_RIGHT;
+}
+
+/* Build a cycle over the play area, the columns are walked when their number is
+ * even, otherwise the rows when theirs is, so the cycle covers every cell.  An odd
+ * by odd play area has no such cycle, its top right cell is left out of it
+ */
+static void build_cycle(autopilot_t *restrict pilot)
+{
+	/* The moves of the area turned on its side, up and left swap, so do down and right */
+	static const unsigned char turned[5] = { MOVE_LEFT, MOVE_RIGHT, MOVE_UP, MOVE_DOWN, MOVE_NONE };
+	const short rows = pilot->config.height - 3;
+	const short cols = pilot->config.width - 3;
+	const int by_rows = cols % 2 != 0 && rows % 2 == 0;
+
+	memset(pilot->cycle, MOVE_NONE, (size_t)pilot->config.height * (size_t)pilot->config.width);
+	for (short r = 0; r < rows; ++r) {
+		for (short c = 0; c < cols; ++c) {
+			unsigned char move = by_rows ? turned[cycle_move(c, r, cols, rows)] :
+				cycle_move(r, c, rows, cols);
+			pilot->cycle[cell_index(pilot, &(cord_t){ r + 2, c + 2 })] = move;
+		}
+	}
+
+	/* Number the cells from the top left one on */
+	memset(pilot->order, 0xff, sizeof(uint32_t) * (size_t)pilot->config.height * (size_t)pilot->config.width);
+	const uint32_t start = cell_index(pilot, &(cord_t){ 2, 2 });
+	uint32_t cell = start, len = 0;
+	do {
+		pilot->order[cell] = len++;
+		cell += pilot->move_offsets[pilot->cycle[cell]];
+	} while (cell != start);
+	pilot->cycle_len = len;
+
+	/* The cell left out sits next to the cells before and after the one below left
+	 * of it, so it takes the place of that one
+	 */
+	pilot->left_out = 0;
+	if (!by_rows && cols % 2 != 0) {
+		pilot->left_out = cell_index(pilot, &(cord_t){ 2, cols + 1 });
+		pilot->order[pilot->left_out] = pilot->order[cell_index(pilot, &(cord_t){ 3, cols })];
+	}
+}
+
+/* Cells walked along the cycle, or against it when reverse is 1, from one cell to
+ * another, the whole cycle when either is off it
+ */
+always_inline uint32_t cycle_distance(const autopilot_t *restrict pilot,
+	uint32_t from, uint32_t to, int reverse)
+{
+	if (pilot->order[from] == UINT32_MAX || pilot->order[to] == UINT32_MAX)
+		return pilot->cycle_len;
+	if (reverse)
+		return (pilot->order[from] + pilot->cycle_len - pilot->order[to]) % pilot->cycle_len;
+	return (pilot->order[to] + pilot->cycle_len - pilot->order[from]) % pilot->cycle_len;
+}
+
+/* Cells walked along the cycle to the food, a whole lap from a cell sharing its place */
+always_inline uint32_t food_distance(const autopilot_t *restrict pilot,
+	uint32_t from, uint32_t food, int reverse)
+{
+	uint32_t distance = cycle_distance(pilot, from, food, reverse);
+	return distance == 0 && from != food ? pilot->cycle_len : distance;
+}
+
+/* Check whether the whole snake lies on the part of the cycle from its tail to its head,
+ * then no step which goes no further along the cycle than the tail can trap the snake
+ */
+static int body_in_order(const autopilot_t *restrict pilot, game_t *restrict game,
+	uint32_t head, uint32_t tail, int reverse)
+{
+	const uint32_t span = cycle_distance(pilot, tail, head, reverse);
+	if (span == pilot->cycle_len)
+		return 0;
+
+	size_t len = game_snake_len(game);
+	for (size_t i = 1; i + 1 < len; ++i) {
+		cord_t node = game_snake_get(game, i);
+		if (cycle_distance(pilot, tail, cell_index(pilot, &node), reverse) > span)
+			return 0;
+	}
+	return 1;
+}
+
+/* Check whether a step keeps the snake along the cycle, it must not pass the tail
+ * nor the food, and only goes to the next cell of the cycle without shortcuts
+ *
+ * Parameters:
+ * ahead: cells of the cycle from the head to the step
+ * to_tail: cells of the cycle from the head to the tail
+ * to_food: cells of the cycle from the head to the food
+ * grows: 1 if the step eats the food, 0 otherwise
+ * shortcuts: 1 if the step may skip cells of the cycle, 0 otherwise
+ *
+ * Return:
+ * 1 if the step keeps the snake along the cycle, 0 otherwise
+ */
+always_inline int step_in_order(uint32_t ahead, uint32_t to_tail, uint32_t to_food,
+	int grows, int shortcuts)
+{
+	if (!shortcuts && ahead != 1)
+		return 0;
+	return ahead <= to_food && (ahead < to_tail || (ahead == to_tail && !grows));
+}
+
+/* Size the search memory for the board of a game */
+static void prepare(autopilot_t *restrict pilot, const game_config_t *restrict config)
+{
+	autopilot_destory(pilot);
+
+	pilot->config = *config;
+	pilot->move_offsets[0] = -config->width;
+	pilot->move_offsets[1] = config->width;
+	pilot->move_offsets[2] = -1;
+	pilot->move_offsets[3] = 1;
+
+	pilot->stamps = (uint32_t *)cells_alloc(config, sizeof(uint32_t));
+	memset(pilot->stamps, 0, sizeof(uint32_t) * (size_t)config->height * (size_t)config->width);
+	pilot->search_stamp = 0;
+	pilot->moves = (unsigned char *)cells_alloc(config, 1);
+	pilot->cycle = (unsigned char *)cells_alloc(config, 1);
+	pilot->order = (uint32_t *)cells_alloc(config, sizeof(uint32_t));
+	pilot->frontier = (uint32_t *)cells_alloc(config, sizeof(uint32_t));
+	pilot->path = (uint32_t *)cells_alloc(config, sizeof(uint32_t));
+	bitboard_init(&pilot->after, config->height, config->width);
+	build_cycle(pilot);
+}
+
+/* Step towards the food without hitting anything, for sparse boards
+ * where the snake is too short to trap itself in the open
+ */
+static unsigned char greedy_next(game_t *restrict game)
+{
+	cord_t head = game_snake_head(game);
+	unsigned char best = MOVE_NONE;
+	int best_distance = 0;
+
+	for (unsigned char move = 0; move < 4; ++move) {
+		cord_t next = { head.y + move_dy[move], head.x + move_dx[move] };
+		if (game_cell_blocked(game, next.y, next.x))
+			continue;
+
+		int distance = abs(next.y - game->food.y) + abs(next.x - game->food.x);
+		if (best == MOVE_NONE || distance < best_distance) {
+			best = move;
+			best_distance = distance;
+		}
+	}
+
+	return best != MOVE_NONE ? move_keys[best] : 0;
+}
+
+void autopilot_init(autopilot_t *restrict pilot)
+{
+	memset(pilot, 0, sizeof(*pilot));
+}
+
+unsigned char autopilot_next(autopilot_t *restrict pilot, game_t *restrict game)
+{
+	if (game->sparse)
+		return greedy_next(game);
+
+	if (memcmp(&pilot->config, &game->config, sizeof(game_config_t)) != 0)
+		prepare(pilot, &game->config);
+	cord_t head_node = game_snake_head(game), tail_node = game_snake_tail(game);
+	uint32_t head = cell_index(pilot, &head_node);
+	uint32_t tail = cell_index(pilot, &tail_node);
+	uint32_t food = cell_index(pilot, &game->food);
+
+	/* Walk the cycle the way the snake lies along it, otherwise the way it heads */
+	int reverse = 0, in_order = body_in_order(pilot, game, head, tail, 0);
+	if (!in_order) {
+		cord_t neck_node = game_snake_get(game, game_snake_len(game) - 2);
+		in_order = body_in_order(pilot, game, head, tail, 1);
+		reverse = in_order || cycle_distance(pilot, head, cell_index(pilot, &neck_node), 0) == 1;
+	}
+
+	/* A food on either cell of the shared position may find the tail on the other on
+	 * every lap, without shortcuts the body closes its gaps in a lap and the tail moves on
+	 */
+	const int shortcuts = pilot->left_out == 0 || pilot->order[food] != pilot->order[pilot->left_out];
+	const uint32_t to_tail = cycle_distance(pilot, head, tail, reverse);
+	const uint32_t to_food = food_distance(pilot, head, food, reverse);
+
+	/* Shortest path to the food, only its first step counts while the snake lies
+	 * along the cycle, and it must not pass the tail nor the food there
+	 */
+	if (search(pilot, &game->blocked, head, food)) {
+		size_t path_len = trace_path(pilot, head, food);
+		unsigned char first = pilot->moves[pilot->path[0]];
+		if (in_order ? step_in_order(cycle_distance(pilot, head, pilot->path[0], reverse),
+				to_tail, to_food, path_len == 1, shortcuts) :
+			path_is_safe(pilot, game, path_len, 1))
+			return move_keys[first];
+	}
+
+	/* Otherwise along the cycle towards the food, or the safe step which skips the least
+	 * of the cycle while the snake does not lie along it yet
+	 */
+	unsigned char best = MOVE_NONE, fallback = MOVE_NONE;
+	uint32_t best_rank = 0;
+	for (unsigned char move = 0; move < 4; ++move) {
+		uint32_t next = head + pilot->move_offsets[move];
+		int grows = next == food;
+
+		/* The tail moves away unless the snake eats */
+		if (cell_blocked(pilot, &game->blocked, next) && (next != tail || grows))
+			continue;
+		if (fallback == MOVE_NONE)
+			fallback = move;
+
+		uint32_t ahead = cycle_distance(pilot, head, next, reverse);
+		if (in_order) {
+			if (!step_in_order(ahead, to_tail, to_food, grows, shortcuts))
+				continue;
+
+			uint32_t rank = food_distance(pilot, next, food, reverse);
+			if (best == MOVE_NONE || rank < best_rank) {
+				best = move;
+				best_rank = rank;
+			}
+		} else if (best == MOVE_NONE || ahead < best_rank) {
+			pilot->path[0] = next;
+			if (path_is_safe(pilot, game, 1, grows)) {
+				best = move;
+				best_rank = ahead;
+			}
+		}
+	}
+
+	/* Nothing is safe, survive as long as possible */
+	if (best == MOVE_NONE)
+		best = fallback;
+	return best != MOVE_NONE ? move_keys[best] : 0;
+}
+
+void autopilot_destory(autopilot_t *restrict pilot)
+{
+	free(pilot->stamps);
+	free(pilot->moves);
+	free(pilot->cycle);
+	free(pilot->order);
+	free(pilot->frontier);
+	free(pilot->path);
+	bitboard_destory(&pilot->after);
+	memset(pilot, 0, sizeof(*pilot));
+}
@@ -0,0 +1,89 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Bot which plays a game by itself, shortest paths to the food while the
+ * tail stays reachable, otherwise a Hamiltonian cycle of the play area which
+ * it keeps to once the snake lies along it, cutting across where it is safe.
+ * Boards too large for a bitboard are played greedily instead
+ */
+#ifndef __SNAKE_AUTOPILOT_H__
+#define __SNAKE_AUTOPILOT_H__
+
+#include "common-def.h"
+#include "bitboard.h"
+#include "engine.h"
+
+#include <stdint.h>
+
+/* Autopilot struct, the search memory is allocated once per board config,
+ * with one entry per cell of the board
+ */
+typedef struct {
+	/* The board the arrays are sized for, width 0 before the first game */
+	game_config_t config;
+	/* Cell offsets of the moves up, down, left and right */
+	int move_offsets[4];
+	/* A cell is seen by the current search when its stamp equals search_stamp */
+	uint32_t *stamps;
+	uint32_t search_stamp;
+	/* Direction each seen cell was entered by */
+	unsigned char *moves;
+	/* Direction to leave each cell by along the cycle, 4 for cells off the cycle */
+	unsigned char *cycle;
+	/* Position of each cell along the cycle, UINT32_MAX outside the play area */
+	uint32_t *order;
+	uint32_t cycle_len;
+	/* The play area cell left out of the cycle, it shares the position of a cell
+	 * next to two of its neighbours, 0 when the cycle covers the whole play area
+	 */
+	uint32_t left_out;
+	/* Cell indexes of the search frontier and of the last path found */
+	uint32_t *frontier;
+	uint32_t *path;
+	/* The board after the snake would have followed the path */
+	bitboard_t after;
+} autopilot_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Initialize an autopilot
+ *
+ * Parameters:
+ * pilot: pointer to an autopilot
+ *
+ * Return:
+ * None
+ *
+ * Note: One autopilot can play any number of games, but only one at a time,
+ *	   its memory is allocated by the first move on a new board config
+ */
+extern void autopilot_init(autopilot_t *restrict pilot);
+
+/* Decide the next move
+ *
+ * Parameters:
+ * pilot: pointer to an autopilot
+ * game: pointer to a running game
+ *
+ * Return:
+ * The direction key to pass to game_step
+ */
+extern unsigned char autopilot_next(autopilot_t *restrict pilot, game_t *restrict game);
+
+/* Destory an autopilot
+ *
+ * Parameters:
+ * pilot: pointer to an autopilot
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it to prevent memory leak
+ */
+extern void autopilot_destory(autopilot_t *restrict pilot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
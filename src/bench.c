@@ -0,0 +1,664 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Microbenchmarks of the queue and the game engine
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "queue.h"
+#include "engine.h"
+#include "autopilot.h"
+#include "mcts.h"
+
+#define QUEUE_CHURN_LEN 1000
+
+#ifdef __GLIBC__
+/* Count heap calls by wrapping the glibc allocator */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long long alloc_count;
+
+void *malloc(size_t size)
+{
+	++alloc_count;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+	++alloc_count;
+	return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	++alloc_count;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+#define ALLOC_COUNTING 1
+#else
+static unsigned long long alloc_count;
+#define ALLOC_COUNTING 0
+#endif
+
+typedef void (*bench_fn_t)(void *ctx, unsigned long iterations);
+
+static struct timespec timer_start, timer_stop;
+static unsigned long long allocs_start, allocs_stop;
+static volatile unsigned long bench_sink;
+
+static double min_seconds = 0.2;
+static int json_output = 0;
+static int first_result = 1;
+
+/* Called by each benchmark around its timed loop */
+always_inline void bench_start(void)
+{
+	allocs_start = alloc_count;
+	clock_gettime(CLOCK_MONOTONIC, &timer_start);
+}
+
+always_inline void bench_stop(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &timer_stop);
+	allocs_stop = alloc_count;
+}
+
+always_inline double elapsed_ns(void)
+{
+	return (double)(timer_stop.tv_sec - timer_start.tv_sec) * 1e9 +
+		(double)(timer_stop.tv_nsec - timer_start.tv_nsec);
+}
+
+/* Double the iterations until a run takes long enough to be stable */
+static void run_bench(const char *name, const char *param, bench_fn_t fn, void *ctx)
+{
+	unsigned long iterations = 1;
+	double ns;
+
+	while (1) {
+		fn(ctx, iterations);
+		ns = elapsed_ns();
+		if (ns >= min_seconds * 1e9 || iterations >= (1UL << 40))
+			break;
+		iterations *= ns < min_seconds * 1e8 ? 10 : 2;
+	}
+
+	double ns_per_op = ns / iterations;
+	double allocs_per_op = (double)(allocs_stop - allocs_start) / iterations;
+
+	if (json_output) {
+		printf("%s{\"name\":\"%s\",\"param\":\"%s\",\"iterations\":%lu,"
+			"\"ns_per_op\":%.3f,\"allocs_per_op\":",
+			first_result ? "[\n" : ",\n", name, param, iterations, ns_per_op);
+		if (ALLOC_COUNTING)
+			printf("%.6f}", allocs_per_op);
+		else
+			printf("null}");
+	} else {
+		printf("%-20s %-22s %14lu %12.2f ", name, param, iterations, ns_per_op);
+		if (ALLOC_COUNTING)
+			printf("%12.6f\n", allocs_per_op);
+		else
+			printf("%12s\n", "n/a");
+	}
+
+	first_result = 0;
+	fflush(stdout);
+}
+
+/* Queue benchmarks */
+typedef struct {
+	size_t step_size;
+	size_t shrink_size;
+} churn_ctx_t;
+
+static void bench_queue_churn(void *ctx, unsigned long iterations)
+{
+	churn_ctx_t *churn = ctx;
+	queue_t queue;
+	cord_t item = { 0, 0 };
+
+	queue_init(&queue, sizeof(cord_t), QUEUE_CHURN_LEN, churn->step_size, churn->shrink_size);
+	for (int i = 0; i < QUEUE_CHURN_LEN; ++i)
+		enqueue(&queue, &item);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		item.x = (short)i;
+		enqueue(&queue, &item);
+		bench_sink += ((cord_t *)dequeue(&queue))->x;
+	}
+	bench_stop();
+
+	queue_destory(&queue);
+}
+
+static void bench_ring_queue_churn(void *ctx, unsigned long iterations)
+{
+	ring_queue_t queue;
+	cord_t item = { 0, 0 };
+
+	ring_queue_init(&queue, sizeof(cord_t), QUEUE_CHURN_LEN + 1);
+	for (int i = 0; i < QUEUE_CHURN_LEN; ++i)
+		ring_enqueue(&queue, &item);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		item.x = (short)i;
+		ring_enqueue(&queue, &item);
+		bench_sink += ((cord_t *)ring_dequeue(&queue))->x;
+	}
+	bench_stop();
+
+	ring_queue_destory(&queue);
+}
+
+static void bench_cord_queue_churn(void *ctx, unsigned long iterations)
+{
+	cord_queue_t queue;
+	cord_t item = { 0, 0 };
+
+	cord_queue_init(&queue, QUEUE_CHURN_LEN + 1);
+	for (int i = 0; i < QUEUE_CHURN_LEN; ++i)
+		cord_queue_push(&queue, item);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		item.x = (short)i;
+		cord_queue_push(&queue, item);
+		bench_sink += cord_queue_pop(&queue).x;
+	}
+	bench_stop();
+
+	cord_queue_destory(&queue);
+}
+
+/* A short lived queue per iteration, from the heap or from an arena */
+static void bench_temp_queue(void *ctx, unsigned long iterations)
+{
+	static unsigned char buffer[64 * 1024];
+	queue_arena_t arena;
+	const queue_allocator_t *allocator = &queue_default_allocator;
+	cord_t item = { 0, 0 };
+
+	if (ctx != NULL) {
+		queue_arena_init(&arena, buffer, sizeof(buffer));
+		allocator = &arena.allocator;
+	}
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		ring_queue_t queue;
+		ring_queue_init_allocator(&queue, sizeof(cord_t), 16, allocator);
+		for (short j = 0; j < 64; ++j) {
+			item.x = j;
+			ring_enqueue(&queue, &item);
+		}
+		bench_sink += ((cord_t *)ring_queue_back(&queue))->x;
+		ring_queue_destory(&queue);
+
+		if (ctx != NULL)
+			queue_arena_reset(&arena);
+	}
+	bench_stop();
+}
+
+static void bench_queue_find(void *ctx, unsigned long iterations)
+{
+	size_t len = *(size_t *)ctx;
+	queue_t queue;
+	cord_t item = { 0, 0 }, missing = { -1, -1 };
+
+	queue_init(&queue, sizeof(cord_t), len, 16, len + 16);
+	for (size_t i = 0; i < len; ++i) {
+		item.x = (short)i;
+		enqueue(&queue, &item);
+	}
+
+	/* The item is never found, so every element is compared */
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i)
+		bench_sink += queue_find_the_first_of(&queue, &missing) == NULL;
+	bench_stop();
+
+	queue_destory(&queue);
+}
+
+static void bench_ring_queue_find(void *ctx, unsigned long iterations)
+{
+	size_t len = *(size_t *)ctx;
+	ring_queue_t queue;
+	cord_t item = { 0, 0 }, missing = { -1, -1 };
+
+	/* Start in the middle of the buffer so the items wrap around */
+	ring_queue_init(&queue, sizeof(cord_t), len);
+	for (size_t i = 0; i < len / 2; ++i)
+		ring_enqueue(&queue, &item);
+	for (size_t i = 0; i < len / 2; ++i)
+		ring_dequeue(&queue);
+	for (size_t i = 0; i < len; ++i) {
+		item.x = (short)i;
+		ring_enqueue(&queue, &item);
+	}
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i)
+		bench_sink += ring_queue_find_the_first_of(&queue, &missing) == NULL;
+	bench_stop();
+
+	ring_queue_destory(&queue);
+}
+
+/* Snake body benchmarks */
+
+/* Segment i of a snake winding through rows of BODY_ROW cells */
+#define BODY_ROW 30000
+#define BODY_WIDTH (BODY_ROW + 4)
+
+always_inline cord_t winding_cell(size_t i)
+{
+	short row = (short)(i / BODY_ROW), col = (short)(i % BODY_ROW);
+	return (cord_t){ row + 2, row % 2 == 0 ? col + 2 : BODY_ROW + 1 - col };
+}
+
+typedef struct {
+	size_t len;
+	int packed;
+} body_ctx_t;
+
+/* Move a snake of len segments forward, one push and one pop per iteration */
+static void bench_body_churn(void *ctx, unsigned long iterations)
+{
+	const body_ctx_t *body = ctx;
+	cord_queue_t queue;
+	packed_body_t packed;
+
+	if (body->packed) {
+		packed_body_init(&packed, body->len, BODY_WIDTH, winding_cell(0));
+		for (size_t i = 1; i < body->len; ++i)
+			packed_body_push(&packed, winding_cell(i));
+	} else {
+		cord_queue_init(&queue, body->len);
+		for (size_t i = 0; i < body->len; ++i)
+			cord_queue_push(&queue, winding_cell(i));
+	}
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		if (body->packed) {
+			bench_sink += packed_body_pop(&packed).x;
+			packed_body_push(&packed, winding_cell(body->len + i));
+		} else {
+			bench_sink += cord_queue_pop(&queue).x;
+			cord_queue_push(&queue, winding_cell(body->len + i));
+		}
+	}
+	bench_stop();
+
+	if (body->packed)
+		packed_body_destory(&packed);
+	else
+		cord_queue_destory(&queue);
+}
+
+/* Read random segments of a snake of len segments */
+static void bench_body_get(void *ctx, unsigned long iterations)
+{
+	const body_ctx_t *body = ctx;
+	cord_queue_t queue;
+	packed_body_t packed;
+	rng_t rng;
+
+	rng_seed(&rng, 1, 0);
+	if (body->packed) {
+		packed_body_init(&packed, body->len, BODY_WIDTH, winding_cell(0));
+		for (size_t i = 1; i < body->len; ++i)
+			packed_body_push(&packed, winding_cell(i));
+	} else {
+		cord_queue_init(&queue, body->len);
+		for (size_t i = 0; i < body->len; ++i)
+			cord_queue_push(&queue, winding_cell(i));
+	}
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		size_t index = rng_bounded(&rng, (uint32_t)body->len);
+		bench_sink += body->packed ? packed_body_get(&packed, index).x :
+			cord_queue_get_item(&queue, index)->x;
+	}
+	bench_stop();
+
+	if (body->packed)
+		packed_body_destory(&packed);
+	else
+		cord_queue_destory(&queue);
+}
+
+/* Engine benchmarks */
+
+/* Board and snake length of a filled board benchmark */
+typedef struct {
+	game_config_t config;
+	size_t len;
+} fill_ctx_t;
+
+/* Replace the initial snake with one winding through the play area */
+static void build_snake(game_t *restrict game, const fill_ctx_t *restrict fill)
+{
+	size_t len = fill->len;
+	game_init_config(game, &fill->config, 1);
+	while (game_snake_len(game) > 0)
+		game_pop_tail(game);
+
+	const game_config_t *config = &game->config;
+	for (short y = 2; y < config->height - 1 && len > 0; ++y) {
+		for (short i = 0; i < config->width - 3 && len > 0; ++i, --len) {
+			cord_t node = { y, y % 2 == 0 ? 2 + i : config->width - 2 - i };
+			game_push_head(game, &node);
+		}
+	}
+}
+
+static void bench_gen_food(void *ctx, unsigned long iterations)
+{
+	game_t game;
+	build_snake(&game, (const fill_ctx_t *)ctx);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i)
+		bench_sink += game_gen_food(&game).x;
+	bench_stop();
+
+	game_destory(&game);
+}
+
+static void bench_check_over(void *ctx, unsigned long iterations)
+{
+	game_t game;
+	build_snake(&game, (const fill_ctx_t *)ctx);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i)
+		bench_sink += game_check_over(&game);
+	bench_stop();
+
+	game_destory(&game);
+}
+
+/* Steer the snake around the play area clockwise */
+always_inline unsigned char circle_input(game_t *restrict game)
+{
+	cord_t head = game_snake_head(game);
+
+	if (game->direction == LEFT_KEY && head.x == 2)
+		return UP_KEY;
+	if (game->direction == UP_KEY && head.y == 2)
+		return RIGHT_KEY;
+	if (game->direction == RIGHT_KEY && head.x == game->config.width - 2)
+		return DOWN_KEY;
+	if (game->direction == DOWN_KEY && head.y == game->config.height - 2)
+		return LEFT_KEY;
+	return 0;
+}
+
+/* The cell the head moves to with an input */
+always_inline cord_t cell_ahead(game_t *restrict game, unsigned char input)
+{
+	cord_t cell = game_snake_head(game);
+	switch (game_can_turn(game, input) ? input : game->direction) {
+		case UP_KEY:
+			--cell.y;
+			break;
+		case DOWN_KEY:
+			++cell.y;
+			break;
+		case LEFT_KEY:
+			--cell.x;
+			break;
+		case RIGHT_KEY:
+			++cell.x;
+			break;
+	}
+	return cell;
+}
+
+/* Board and step function of a tick benchmark, feeding puts the food
+ * in front of the head so every tick places new food
+ */
+typedef struct {
+	game_config_t config;
+	unsigned char (*step)(game_t *restrict game, unsigned char input);
+	int feed;
+} tick_ctx_t;
+
+static void bench_tick(void *ctx, unsigned long iterations)
+{
+	const tick_ctx_t *tick = ctx;
+	game_t game;
+	unsigned long seed = 1;
+
+	game_init_config(&game, &tick->config, seed);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		unsigned char input = circle_input(&game);
+		if (tick->feed)
+			game.food = cell_ahead(&game, input);
+		if (tick->step(&game, input) != GAME_RUNNING) {
+			game_destory(&game);
+			game_init_config(&game, &tick->config, ++seed);
+		}
+	}
+	bench_stop();
+
+	game_destory(&game);
+}
+
+/* Start and free a whole game, the board size must not matter */
+static void bench_game_init(void *ctx, unsigned long iterations)
+{
+	const game_config_t *config = ctx;
+	game_t game;
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		game_init_config(&game, config, i);
+		bench_sink += game.food.x;
+		game_destory(&game);
+	}
+	bench_stop();
+}
+
+static void bench_game_copy(void *ctx, unsigned long iterations)
+{
+	game_t game, snapshot;
+	build_snake(&game, (const fill_ctx_t *)ctx);
+	game_init(&snapshot, 0);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		game_copy(&snapshot, &game);
+		bench_sink += snapshot.food.x;
+	}
+	bench_stop();
+
+	game_destory(&snapshot);
+	game_destory(&game);
+}
+
+/* One single threaded decision with all iterations as rollouts */
+static void bench_mcts_rollout(void *ctx, unsigned long iterations)
+{
+	mcts_t mcts;
+	game_t game;
+
+	mcts_init(&mcts, 1, 0, iterations, 1);
+	game_init(&game, 1);
+
+	bench_start();
+	bench_sink += mcts_next(&mcts, &game);
+	bench_stop();
+
+	game_destory(&game);
+	mcts_destory(&mcts);
+}
+
+/* One decision per iteration, the game restarts when it ends */
+static void bench_autopilot(void *ctx, unsigned long iterations)
+{
+	static autopilot_t pilot;
+	game_t game;
+	unsigned long seed = 1;
+
+	autopilot_init(&pilot);
+	game_init(&game, seed);
+
+	bench_start();
+	for (unsigned long i = 0; i < iterations; ++i) {
+		if (game_step(&game, autopilot_next(&pilot, &game)) != GAME_RUNNING) {
+			game_destory(&game);
+			game_init(&game, ++seed);
+		}
+	}
+	bench_stop();
+
+	game_destory(&game);
+	autopilot_destory(&pilot);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "jt:")) != -1) {
+		switch (opt) {
+			case 'j':
+				json_output = 1;
+				break;
+			case 't':
+				min_seconds = strtod(optarg, NULL);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-j] [-t min_seconds]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (!json_output)
+		printf("%-20s %-22s %14s %12s %12s\n",
+			"benchmark", "param", "iterations", "ns/op", "allocs/op");
+
+	char param[32];
+
+	static churn_ctx_t churn[] = { { 16, 64 }, { 64, 512 }, { 1024, 4096 } };
+	for (size_t i = 0; i < sizeof(churn) / sizeof(churn[0]); ++i) {
+		snprintf(param, sizeof(param), "step=%zu,shrink=%zu",
+			churn[i].step_size, churn[i].shrink_size);
+		run_bench("queue_churn", param, bench_queue_churn, &churn[i]);
+	}
+	run_bench("ring_queue_churn", "-", bench_ring_queue_churn, NULL);
+	run_bench("cord_queue_churn", "-", bench_cord_queue_churn, NULL);
+	run_bench("temp_queue", "heap", bench_temp_queue, NULL);
+	run_bench("temp_queue", "arena", bench_temp_queue, "arena");
+
+	static size_t find_lens[] = { 16, 256, 4096, 32768 };
+	for (size_t i = 0; i < sizeof(find_lens) / sizeof(find_lens[0]); ++i) {
+		snprintf(param, sizeof(param), "len=%zu", find_lens[i]);
+		run_bench("queue_find_first_of", param, bench_queue_find, &find_lens[i]);
+	}
+	for (size_t i = 0; i < sizeof(find_lens) / sizeof(find_lens[0]); ++i) {
+		snprintf(param, sizeof(param), "len=%zu", find_lens[i]);
+		run_bench("ring_queue_find", param, bench_ring_queue_find, &find_lens[i]);
+	}
+
+	static body_ctx_t bodies[] = {
+		{ 4096, 0 }, { 4096, 1 }, { 1 << 20, 0 }, { 1 << 20, 1 }
+	};
+	for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); ++i) {
+		snprintf(param, sizeof(param), "%s,len=%zu",
+			bodies[i].packed ? "packed" : "cord_queue", bodies[i].len);
+		run_bench("body_churn", param, bench_body_churn, &bodies[i]);
+	}
+	for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); ++i) {
+		snprintf(param, sizeof(param), "%s,len=%zu",
+			bodies[i].packed ? "packed" : "cord_queue", bodies[i].len);
+		run_bench("body_get", param, bench_body_get, &bodies[i]);
+	}
+
+	/* The default board, then the largest board kept on a bitboard */
+	static fill_ctx_t fills[6];
+	static const char *const fill_names[3] = { "empty", "half", "nearly_full" };
+	for (size_t b = 0; b < 2; ++b) {
+		game_config_t config = b == 0 ? game_default_config :
+			(game_config_t){ 256, 256, 253 * 253 - 1 };
+		const size_t play_area = (size_t)(config.height - 3) * (size_t)(config.width - 3);
+		fills[b * 3] = (fill_ctx_t){ config, 3 };
+		fills[b * 3 + 1] = (fill_ctx_t){ config, play_area / 2 };
+		fills[b * 3 + 2] = (fill_ctx_t){ config, play_area * 99 / 100 };
+	}
+	for (size_t i = 0; i < 6; ++i) {
+		snprintf(param, sizeof(param), "%s,%dx%d,len=%zu", fill_names[i % 3],
+			fills[i].config.width, fills[i].config.height, fills[i].len);
+		run_bench("gen_food", param, bench_gen_food, &fills[i]);
+	}
+	for (size_t i = 0; i < 3; ++i) {
+		snprintf(param, sizeof(param), "len=%zu", fills[i].len);
+		run_bench("check_over", param, bench_check_over, &fills[i]);
+	}
+
+	for (size_t i = 0; i < 6; ++i) {
+		snprintf(param, sizeof(param), "%dx%d,len=%zu",
+			fills[i].config.width, fills[i].config.height, fills[i].len);
+		run_bench("game_copy", param, bench_game_copy, &fills[i]);
+	}
+
+	static game_config_t boards[2];
+	boards[0] = game_default_config;
+	boards[1] = (game_config_t){ 4096, 4096, WIN_SNAKE_SIZE };
+	for (size_t i = 0; i < sizeof(boards) / sizeof(boards[0]); ++i) {
+		snprintf(param, sizeof(param), "%dx%d", boards[i].width, boards[i].height);
+		run_bench("game_init", param, bench_game_init, &boards[i]);
+	}
+
+	run_bench("mcts_rollout", "-", bench_mcts_rollout, NULL);
+
+	/* Every specialized board against the generic step, then a sparse board */
+	static tick_ctx_t ticks[16];
+	static const short tick_sizes[][2] = { { 64, 16 }, { 64, 64 }, { 128, 128 } };
+	size_t tick_num = 0;
+	for (int feed = 0; feed < 2; ++feed) {
+		for (size_t i = 0; i < sizeof(tick_sizes) / sizeof(tick_sizes[0]); ++i) {
+			game_config_t config = { tick_sizes[i][0], tick_sizes[i][1], WIN_SNAKE_SIZE };
+			/* A fed snake grows until it runs into itself */
+			if (feed)
+				config.win_size = (config.height - 3) * (config.width - 3) - 1;
+			ticks[tick_num++] = (tick_ctx_t){ config, game_step, feed };
+			ticks[tick_num++] = (tick_ctx_t){ config, game_step_generic, feed };
+		}
+	}
+	ticks[tick_num++] = (tick_ctx_t){ { 4096, 4096, WIN_SNAKE_SIZE }, game_step, 0 };
+
+	for (size_t i = 0; i < tick_num; ++i) {
+		snprintf(param, sizeof(param), "%s,%dx%d,%s", ticks[i].feed ? "feed" : "circle",
+			ticks[i].config.width, ticks[i].config.height,
+			ticks[i].step == game_step ? "dispatch" : "generic");
+		run_bench("tick", param, bench_tick, &ticks[i]);
+	}
+	run_bench("tick", "autopilot", bench_autopilot, NULL);
+
+	if (json_output)
+		puts(first_result ? "[]" : "\n]");
+
+	return EXIT_SUCCESS;
+}
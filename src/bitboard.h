@@ -0,0 +1,253 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * One bit per board cell, a row is a whole number of 64 bit words
+ */
+#ifndef __SNAKE_BITBOARD_H__
+#define __SNAKE_BITBOARD_H__
+
+#include "common-def.h"
+#include "queue.h"
+#include "snake.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+/* Bitboard struct, bit x % 64 of word x / 64 of a row is column x */
+typedef struct {
+	/* Words per row, a 64 column board has exactly one */
+	unsigned int words;
+	unsigned int height;
+	uint64_t *rows;
+} bitboard_t;
+
+always_inline unsigned int bit_count(uint64_t word)
+{
+#ifdef _MSC_VER
+	return (unsigned int)__popcnt64(word);
+#else
+	return (unsigned int)__builtin_popcountll(word);
+#endif
+}
+
+always_inline unsigned int bit_lowest(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctzll(word);
+#endif
+}
+
+/* Find the k-th set bit of a word
+ *
+ * Parameters:
+ * word: a word with more than k bits set
+ * k: index of the set bit, counting from 0
+ *
+ * Return:
+ * Position of the bit
+ */
+always_inline unsigned int bit_select(uint64_t word, unsigned int k)
+{
+#ifdef __BMI2__
+	/* Deposit a single bit onto the k-th set bit */
+	return bit_lowest(_pdep_u64(1ULL << k, word));
+#else
+	/* Narrow down by halves */
+	unsigned int pos = 0;
+	for (unsigned int width = 32; width > 0; width >>= 1) {
+		unsigned int low = bit_count(word & ((1ULL << width) - 1));
+		if (k >= low) {
+			k -= low;
+			word >>= width;
+			pos += width;
+		}
+	}
+	return pos;
+#endif
+}
+
+always_inline uint64_t bitboard_mask(short x)
+{
+	return 1ULL << (x % 64);
+}
+
+always_inline uint64_t *bitboard_word(const bitboard_t *restrict board, short y, short x)
+{
+	return &board->rows[(size_t)y * board->words + x / 64];
+}
+
+always_inline int bitboard_test(const bitboard_t *restrict board, short y, short x)
+{
+	return (*bitboard_word(board, y, x) & bitboard_mask(x)) != 0;
+}
+
+always_inline void bitboard_set(bitboard_t *restrict board, short y, short x)
+{
+	*bitboard_word(board, y, x) |= bitboard_mask(x);
+}
+
+always_inline void bitboard_clear(bitboard_t *restrict board, short y, short x)
+{
+	*bitboard_word(board, y, x) &= ~bitboard_mask(x);
+}
+
+/* Allocate a board with every bit set
+ *
+ * Parameters:
+ * board: pointer to a board
+ * height: number of rows
+ * width: number of columns
+ *
+ * Return:
+ * None
+ */
+always_inline void bitboard_init(bitboard_t *restrict board, short height, short width)
+{
+	board->words = ((unsigned int)width + 63) / 64;
+	board->height = (unsigned int)height;
+	if ((board->rows = (uint64_t *)queue_heap_alloc(
+			sizeof(uint64_t) * board->words * board->height)) == NULL) {
+		fputs("Bitboard->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	memset(board->rows, 0xff, sizeof(uint64_t) * board->words * board->height);
+}
+
+/* Copy the bits of a board into another one of the same size */
+always_inline void bitboard_copy(bitboard_t *restrict dst, const bitboard_t *restrict src)
+{
+	memcpy(dst->rows, src->rows, sizeof(uint64_t) * src->words * src->height);
+}
+
+always_inline void bitboard_destory(bitboard_t *restrict board)
+{
+	queue_heap_release(board->rows, sizeof(uint64_t) * board->words * board->height);
+}
+
+/* Words of a block and blocks of a band, a band has at most 16384 clear bits */
+#define BITBOARD_BLOCK_WORDS 16U
+#define BITBOARD_BAND_BLOCKS 16U
+
+/* Clear bits of every band and every block of a board, kept in sync by the
+ * owner of the board, so the k-th clear bit is found in a few steps
+ */
+typedef struct {
+	uint16_t *bands;
+	uint16_t *blocks;
+	unsigned int band_num;
+	unsigned int block_num;
+} bitboard_counts_t;
+
+/* Allocate the counts of a board and count its clear bits
+ *
+ * Parameters:
+ * counts: pointer to the counts
+ * board: pointer to a board whose unused high bits are set
+ *
+ * Return:
+ * None
+ */
+always_inline void bitboard_counts_init(bitboard_counts_t *restrict counts,
+	const bitboard_t *restrict board)
+{
+	const unsigned int words = board->words * board->height;
+	counts->block_num = (words + BITBOARD_BLOCK_WORDS - 1) / BITBOARD_BLOCK_WORDS;
+	counts->band_num = (counts->block_num + BITBOARD_BAND_BLOCKS - 1) / BITBOARD_BAND_BLOCKS;
+
+	counts->bands = (uint16_t *)queue_heap_alloc(
+		sizeof(uint16_t) * (counts->band_num + counts->block_num));
+	if (counts->bands == NULL) {
+		fputs("Bitboard->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	counts->blocks = counts->bands + counts->band_num;
+}
+
+/* Count the clear bits of a board again after it was changed as a whole */
+always_inline void bitboard_counts_reset(bitboard_counts_t *restrict counts,
+	const bitboard_t *restrict board)
+{
+	const size_t words = (size_t)board->words * board->height;
+	memset(counts->bands, 0, sizeof(uint16_t) * (counts->band_num + counts->block_num));
+	for (size_t w = 0; w < words; ++w) {
+		unsigned int clear = bit_count(~board->rows[w]);
+		counts->blocks[w / BITBOARD_BLOCK_WORDS] += (uint16_t)clear;
+		counts->bands[w / (BITBOARD_BLOCK_WORDS * BITBOARD_BAND_BLOCKS)] += (uint16_t)clear;
+	}
+}
+
+/* Add to the clear bits of a word, -1 after setting a bit and 1 after clearing one */
+always_inline void bitboard_counts_add(bitboard_counts_t *restrict counts,
+	const bitboard_t *restrict board, const uint64_t *restrict word, int delta)
+{
+	size_t w = (size_t)(word - board->rows);
+	counts->blocks[w / BITBOARD_BLOCK_WORDS] += (uint16_t)delta;
+	counts->bands[w / (BITBOARD_BLOCK_WORDS * BITBOARD_BAND_BLOCKS)] += (uint16_t)delta;
+}
+
+/* Find the k-th clear bit of a board in row major order
+ *
+ * Parameters:
+ * counts: pointer to the counts of the board
+ * board: pointer to a board whose unused high bits are set
+ * k: index of the clear bit, it must be less than the clear bits of the board
+ *
+ * Return:
+ * Cell of the bit
+ *
+ * Note: Whole bands and blocks are skipped by their counts, then at most
+ *	   BITBOARD_BLOCK_WORDS words are counted
+ */
+always_inline cord_t bitboard_counts_select(const bitboard_counts_t *restrict counts,
+	const bitboard_t *restrict board, unsigned int k)
+{
+	size_t band = 0;
+	for (; k >= counts->bands[band]; ++band)
+		k -= counts->bands[band];
+
+	size_t block = band * BITBOARD_BAND_BLOCKS;
+	for (; k >= counts->blocks[block]; ++block)
+		k -= counts->blocks[block];
+
+	for (size_t w = block * BITBOARD_BLOCK_WORDS;; ++w) {
+		uint64_t clear = ~board->rows[w];
+		unsigned int count = bit_count(clear);
+		if (k < count)
+			return (cord_t){ (short)(w / board->words),
+				(short)(w % board->words * 64 + bit_select(clear, k)) };
+		k -= count;
+	}
+}
+
+/* Get the clear bits of the whole board */
+always_inline unsigned int bitboard_counts_total(const bitboard_counts_t *restrict counts)
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < counts->band_num; ++i)
+		total += counts->bands[i];
+	return total;
+}
+
+/* Copy the counts of a board into those of another one of the same size */
+always_inline void bitboard_counts_copy(bitboard_counts_t *restrict dst,
+	const bitboard_counts_t *restrict src)
+{
+	memcpy(dst->bands, src->bands, sizeof(uint16_t) * (src->band_num + src->block_num));
+}
+
+always_inline void bitboard_counts_destory(bitboard_counts_t *restrict counts)
+{
+	queue_heap_release(counts->bands, sizeof(uint16_t) * (counts->band_num + counts->block_num));
+}
+
+#endif
@@ -0,0 +1,210 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Packed snake body, the tail and head cells plus a 2 bit move between
+ * every two segments, with the cell index of every 16th segment for
+ * random access. Half a byte per segment instead of a whole cord_t
+ */
+#ifndef __SNAKE_BODY_H__
+#define __SNAKE_BODY_H__
+
+#include "common-def.h"
+#include "bitboard.h"
+#include "queue.h"
+#include "snake.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Segments between two checkpoints, a lookup walks fewer moves than this */
+#define PACKED_BODY_CHECKPOINT 16
+/* Moves in one word of the move ring */
+#define PACKED_BODY_WORD_MOVES 32
+
+/* Packed body struct, segments are numbered from the first tail on and
+ * the numbers only grow, so a number picks its ring slots directly
+ */
+typedef struct {
+	/* Move from each segment to the next one towards the head */
+	uint64_t *moves;
+	/* Cell index of every segment numbered a multiple of PACKED_BODY_CHECKPOINT */
+	uint32_t *checkpoints;
+	uint64_t move_mask;
+	uint64_t checkpoint_mask;
+	uint64_t tail_num;
+	uint64_t head_num;
+	cord_t tail;
+	cord_t head;
+	/* Board width, to turn cell indexes back into cords */
+	short width;
+} packed_body_t;
+
+always_inline size_t packed_body_pow2(size_t size)
+{
+	size_t capacity = 1;
+	while (capacity < size)
+		capacity <<= 1;
+	return capacity;
+}
+
+always_inline unsigned int packed_body_move_of(cord_t from, cord_t to)
+{
+	if (to.y != from.y)
+		return to.y < from.y ? 0 : 1;
+	return to.x < from.x ? 2 : 3;
+}
+
+always_inline unsigned int packed_body_move(const packed_body_t *restrict body, uint64_t num)
+{
+	uint64_t slot = num & body->move_mask;
+	return (unsigned int)(body->moves[slot / PACKED_BODY_WORD_MOVES] >>
+		(slot % PACKED_BODY_WORD_MOVES * 2)) & 3;
+}
+
+/* Moves are up, down, left and right */
+always_inline cord_t packed_body_step(cord_t cell, unsigned int move)
+{
+	static const short dy[4] = { -1, 1, 0, 0 };
+	static const short dx[4] = { 0, 0, -1, 1 };
+	return (cord_t){ cell.y + dy[move], cell.x + dx[move] };
+}
+
+/* Initialize a body with a single segment
+ *
+ * Parameters:
+ * body: pointer to a body
+ * max_len: the most segments it will ever hold
+ * width: the board width
+ * tail: the only segment
+ *
+ * Return:
+ * None
+ *
+ * Note: Nothing is allocated later on while it holds at most max_len segments
+ */
+always_inline void packed_body_init(packed_body_t *restrict body, size_t max_len,
+	short width, cord_t tail)
+{
+	size_t move_capacity = packed_body_pow2(max_len > PACKED_BODY_WORD_MOVES ?
+		max_len : PACKED_BODY_WORD_MOVES);
+	size_t checkpoint_capacity = packed_body_pow2(max_len / PACKED_BODY_CHECKPOINT + 2);
+
+	body->moves = (uint64_t *)queue_heap_alloc(
+		sizeof(uint64_t) * (move_capacity / PACKED_BODY_WORD_MOVES));
+	body->checkpoints = (uint32_t *)queue_heap_alloc(sizeof(uint32_t) * checkpoint_capacity);
+	if (body->moves == NULL || body->checkpoints == NULL) {
+		fputs("Body->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	memset(body->moves, 0, sizeof(uint64_t) * (move_capacity / PACKED_BODY_WORD_MOVES));
+
+	body->move_mask = move_capacity - 1;
+	body->checkpoint_mask = checkpoint_capacity - 1;
+	body->tail_num = body->head_num = 0;
+	body->tail = body->head = tail;
+	body->width = width;
+	body->checkpoints[0] = (uint32_t)tail.y * (uint32_t)width + (uint32_t)tail.x;
+}
+
+always_inline size_t packed_body_len(const packed_body_t *restrict body)
+{
+	return (size_t)(body->head_num - body->tail_num + 1);
+}
+
+/* Add a head next to the current one
+ *
+ * Parameters:
+ * body: pointer to a body
+ * head: the new head, one cell away from the current head
+ *
+ * Return:
+ * None
+ */
+always_inline void packed_body_push(packed_body_t *restrict body, cord_t head)
+{
+	uint64_t slot = body->head_num & body->move_mask;
+	uint64_t *word = &body->moves[slot / PACKED_BODY_WORD_MOVES];
+	unsigned int shift = (unsigned int)(slot % PACKED_BODY_WORD_MOVES * 2);
+
+	*word = (*word & ~(3ULL << shift)) |
+		(uint64_t)packed_body_move_of(body->head, head) << shift;
+	body->head = head;
+
+	if (++body->head_num % PACKED_BODY_CHECKPOINT == 0)
+		body->checkpoints[(body->head_num / PACKED_BODY_CHECKPOINT) & body->checkpoint_mask] =
+			(uint32_t)head.y * (uint32_t)body->width + (uint32_t)head.x;
+}
+
+/* Remove the tail, the body must have more than one segment */
+always_inline cord_t packed_body_pop(packed_body_t *restrict body)
+{
+	cord_t tail = body->tail;
+	body->tail = packed_body_step(tail, packed_body_move(body, body->tail_num++));
+	return tail;
+}
+
+/* Add up the moves of segments from to num - 1, a checkpoint group of
+ * moves never crosses a word so this takes one word and four bit counts
+ */
+always_inline cord_t packed_body_walk(const packed_body_t *restrict body,
+	cord_t cell, uint64_t from, uint64_t num)
+{
+	const uint64_t odd = 0x5555555555555555ULL;
+	uint64_t slot = from & body->move_mask;
+	uint64_t moves = body->moves[slot / PACKED_BODY_WORD_MOVES] >>
+		(slot % PACKED_BODY_WORD_MOVES * 2);
+	uint64_t used = odd & ((1ULL << (num - from) * 2) - 1);
+	uint64_t low = moves & used, high = (moves >> 1) & used;
+
+	cell.y += (short)bit_count(low & ~high) - (short)bit_count(used & ~(low | high));
+	cell.x += (short)bit_count(low & high) - (short)bit_count(high & ~low);
+	return cell;
+}
+
+/* Get a segment
+ *
+ * Parameters:
+ * body: pointer to a body
+ * index: index of the segment from the tail, less than packed_body_len()
+ *
+ * Return:
+ * The cell of the segment
+ *
+ * Note: Starts from the closest checkpoint or the tail, both in the same
+ *	   group of PACKED_BODY_CHECKPOINT moves, so the cost does not depend on index
+ */
+always_inline cord_t packed_body_get(const packed_body_t *restrict body, size_t index)
+{
+	uint64_t num = body->tail_num + index;
+	uint64_t from = num - num % PACKED_BODY_CHECKPOINT;
+
+	if (from < body->tail_num)
+		return packed_body_walk(body, body->tail, body->tail_num, num);
+
+	uint32_t checkpoint =
+		body->checkpoints[(from / PACKED_BODY_CHECKPOINT) & body->checkpoint_mask];
+	return packed_body_walk(body, (cord_t){ (short)(checkpoint / (uint32_t)body->width),
+		(short)(checkpoint % (uint32_t)body->width) }, from, num);
+}
+
+/* Copy a body into another one made for the same max_len */
+always_inline void packed_body_copy(packed_body_t *restrict dst, const packed_body_t *restrict src)
+{
+	uint64_t *moves = dst->moves;
+	uint32_t *checkpoints = dst->checkpoints;
+
+	memcpy(moves, src->moves, sizeof(uint64_t) * ((src->move_mask + 1) / PACKED_BODY_WORD_MOVES));
+	memcpy(checkpoints, src->checkpoints, sizeof(uint32_t) * (src->checkpoint_mask + 1));
+	*dst = *src;
+	dst->moves = moves;
+	dst->checkpoints = checkpoints;
+}
+
+always_inline void packed_body_destory(packed_body_t *restrict body)
+{
+	queue_heap_release(body->moves,
+		sizeof(uint64_t) * ((body->move_mask + 1) / PACKED_BODY_WORD_MOVES));
+	queue_heap_release(body->checkpoints, sizeof(uint32_t) * (body->checkpoint_mask + 1));
+}
+
+#endif
@@ -0,0 +1,127 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Open addressing hash set of board cells, its size follows the number
+ * of cells in it instead of the board area
+ */
+#ifndef __SNAKE_CELLSET_H__
+#define __SNAKE_CELLSET_H__
+
+#include "common-def.h"
+#include "queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Cell set struct, slots hold cell indexes plus 1 and 0 when empty */
+typedef struct {
+	uint32_t *slots;
+	uint32_t mask;
+	unsigned int shift;
+} cell_set_t;
+
+/* Allocate an empty set
+ *
+ * Parameters:
+ * set: pointer to a set
+ * max_cells: the most cells the set will ever hold
+ *
+ * Return:
+ * None
+ *
+ * Note: The table is kept at most half full, so probes stay short
+ */
+always_inline void cell_set_init(cell_set_t *restrict set, size_t max_cells)
+{
+	unsigned int bits = 4;
+	while (((size_t)1 << bits) < 2 * max_cells)
+		++bits;
+
+	if ((set->slots = (uint32_t *)queue_heap_alloc(sizeof(uint32_t) << bits)) == NULL) {
+		fputs("Cellset->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	memset(set->slots, 0, sizeof(uint32_t) << bits);
+	set->mask = (uint32_t)(((size_t)1 << bits) - 1);
+	set->shift = 32 - bits;
+}
+
+/* Fibonacci hashing, neighbouring cells land far apart */
+always_inline uint32_t cell_set_home(const cell_set_t *restrict set, uint32_t key)
+{
+	return (uint32_t)(key * 0x9E3779B1U) >> set->shift;
+}
+
+always_inline int cell_set_has(const cell_set_t *restrict set, uint32_t cell)
+{
+	uint32_t key = cell + 1;
+	for (uint32_t i = cell_set_home(set, key); set->slots[i] != 0; i = (i + 1) & set->mask) {
+		if (set->slots[i] == key)
+			return 1;
+	}
+	return 0;
+}
+
+/* Add a cell to a set
+ *
+ * Parameters:
+ * set: pointer to a set
+ * cell: the cell index
+ *
+ * Return:
+ * 1 if the cell was already in the set, 0 otherwise
+ */
+always_inline int cell_set_insert(cell_set_t *restrict set, uint32_t cell)
+{
+	uint32_t key = cell + 1;
+	uint32_t i = cell_set_home(set, key);
+	for (; set->slots[i] != 0; i = (i + 1) & set->mask) {
+		if (set->slots[i] == key)
+			return 1;
+	}
+	set->slots[i] = key;
+	return 0;
+}
+
+/* Remove a cell from a set, the later slots of its run are shifted back
+ * so lookups never need tombstones
+ *
+ * Parameters:
+ * set: pointer to a set
+ * cell: the cell index
+ *
+ * Return:
+ * None
+ */
+always_inline void cell_set_remove(cell_set_t *restrict set, uint32_t cell)
+{
+	uint32_t key = cell + 1;
+	uint32_t i = cell_set_home(set, key);
+	for (; set->slots[i] != key; i = (i + 1) & set->mask) {
+		if (set->slots[i] == 0)
+			return;
+	}
+
+	for (uint32_t j = (i + 1) & set->mask; set->slots[j] != 0; j = (j + 1) & set->mask) {
+		/* A key may fill the hole unless its home lies between the hole and itself */
+		uint32_t home = cell_set_home(set, set->slots[j]);
+		if (((j - home) & set->mask) >= ((j - i) & set->mask)) {
+			set->slots[i] = set->slots[j];
+			i = j;
+		}
+	}
+	set->slots[i] = 0;
+}
+
+/* Copy the cells of a set into another one of the same size */
+always_inline void cell_set_copy(cell_set_t *restrict dst, const cell_set_t *restrict src)
+{
+	memcpy(dst->slots, src->slots, sizeof(uint32_t) * ((size_t)src->mask + 1));
+}
+
+always_inline void cell_set_destory(cell_set_t *restrict set)
+{
+	queue_heap_release(set->slots, sizeof(uint32_t) * ((size_t)set->mask + 1));
+}
+
+#endif
@@ -12,4 +12,13 @@
 #define always_inline static __attribute__((always_inline))
 #endif
 
+/* thread local storage keyword */
+#ifdef _MSC_VER
+#define thread_local_var __declspec(thread)
+#endif
+
+#ifdef __GNUC__
+#define thread_local_var __thread
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,402 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "engine.h"
+#include "profile.h"
+
+/* Mandatory requirements to have a sensible default borad size */
+static_assert(BOARD_WIDTH > 8 && BOARD_WIDTH <= SHRT_MAX,
+	"BOARD_WIDTH is not valid in snake.h!");
+static_assert(BOARD_HEIGHT > 8 && BOARD_HEIGHT <= SHRT_MAX,
+	"BOARD_HEIGHT is not valid in snake.h!");
+static_assert(WIN_SNAKE_SIZE > 3 && WIN_SNAKE_SIZE < (BOARD_HEIGHT - 3) * (BOARD_WIDTH - 3),
+	"WIN_SNAKE_SIZE is not valid in snake.h!");
+
+const game_config_t game_default_config = { BOARD_WIDTH, BOARD_HEIGHT, WIN_SNAKE_SIZE };
+
+/* Rows and columns 2 to size - 2 are played on, the rest are walls */
+always_inline uint32_t play_area(const game_config_t *restrict config)
+{
+	return (uint32_t)(config->height - 3) * (uint32_t)(config->width - 3);
+}
+
+/* Shape of the board a step works on, every field of it is a constant
+ * in the steps specialized for one board size
+ */
+typedef struct {
+	unsigned char sparse;
+	short width;
+	short height;
+	bitboard_t blocked;
+} shape_t;
+
+/* The shape of any board, known only at runtime */
+always_inline shape_t game_shape(const game_t *restrict game)
+{
+	return (shape_t){ game->sparse, game->config.width, game->config.height, game->blocked };
+}
+
+/* The shape of a dense width x height board */
+#define SHAPE_OF(game, w, h) \
+	((shape_t){ 0, (w), (h), { ((w) + 63) / 64, (h), (game)->blocked.rows } })
+
+always_inline uint32_t cell_index(short width, const cord_t *restrict cord)
+{
+	return (uint32_t)cord->y * (uint32_t)width + (uint32_t)cord->x;
+}
+
+/* Block everything but the play area, whose rows are all the same */
+always_inline void blocked_reset(bitboard_t *restrict blocked, const game_config_t *restrict config)
+{
+	uint64_t *inner = bitboard_word(blocked, 2, 0);
+	for (short j = 2; j < config->width - 1; ++j)
+		bitboard_clear(blocked, 2, j);
+
+	for (short i = 3; i < config->height - 1; ++i)
+		memcpy(bitboard_word(blocked, i, 0), inner, sizeof(uint64_t) * blocked->words);
+}
+
+/* Allocate the snake and its board for a config, a sparse snake starts
+ * as the tail alone and a dense one empty
+ */
+always_inline void board_init(game_t *restrict game, const game_config_t *restrict config,
+	cord_t tail)
+{
+	game->config = *config;
+	game->sparse = (uint32_t)config->height * (uint32_t)config->width > GAME_DENSE_CELLS;
+
+	if (game->sparse) {
+		packed_body_init(&game->packed, config->win_size, config->width, tail);
+		cell_set_init(&game->body, config->win_size);
+	} else {
+		cord_queue_init(&game->snake, config->win_size);
+		bitboard_init(&game->blocked, config->height, config->width);
+		bitboard_counts_init(&game->free_counts, &game->blocked);
+	}
+
+	/* Pick the step of the board size */
+	game->board_kind = GAME_BOARD_GENERIC;
+#define GAME_BOARD_MATCH(w, h) \
+	if (!game->sparse && config->width == (w) && config->height == (h)) \
+		game->board_kind = GAME_BOARD_##w##x##h;
+	GAME_SPECIALIZED_BOARDS(GAME_BOARD_MATCH)
+#undef GAME_BOARD_MATCH
+}
+
+always_inline size_t snake_len(const game_t *restrict game, shape_t shape)
+{
+	return shape.sparse ? packed_body_len(&game->packed) : cord_queue_len(&game->snake);
+}
+
+always_inline cord_t snake_head(const game_t *restrict game, shape_t shape)
+{
+	return shape.sparse ? game->packed.head : *cord_queue_back(&game->snake);
+}
+
+always_inline void snake_push_head(game_t *restrict game, shape_t shape,
+	const cord_t *restrict head_node)
+{
+	if (shape.sparse) {
+		packed_body_push(&game->packed, *head_node);
+
+		int wall = head_node->y <= 1 || head_node->x <= 1 ||
+			head_node->y >= shape.height - 1 || head_node->x >= shape.width - 1;
+		game->head_blocked = cell_set_insert(&game->body, cell_index(shape.width, head_node)) | wall;
+		return;
+	}
+
+	cord_queue_push(&game->snake, *head_node);
+
+	/* Walls and the body are hit by the same AND */
+	uint64_t *word = bitboard_word(&shape.blocked, head_node->y, head_node->x);
+	uint64_t mask = bitboard_mask(head_node->x);
+	game->head_blocked = (*word & mask) != 0;
+	*word |= mask;
+	bitboard_counts_add(&game->free_counts, &shape.blocked, word, (int)game->head_blocked - 1);
+}
+
+always_inline cord_t snake_pop_tail(game_t *restrict game, shape_t shape)
+{
+	cord_t tail_node;
+	if (shape.sparse) {
+		tail_node = packed_body_pop(&game->packed);
+		cell_set_remove(&game->body, cell_index(shape.width, &tail_node));
+	} else {
+		tail_node = cord_queue_pop(&game->snake);
+		uint64_t *word = bitboard_word(&shape.blocked, tail_node.y, tail_node.x);
+		*word &= ~bitboard_mask(tail_node.x);
+		bitboard_counts_add(&game->free_counts, &shape.blocked, word, 1);
+	}
+	return tail_node;
+}
+
+always_inline cord_t gen_food(game_t *restrict game, shape_t shape)
+{
+	if (!shape.sparse) {
+		unsigned int free_count = bitboard_counts_total(&game->free_counts);
+		return bitboard_counts_select(&game->free_counts, &shape.blocked,
+			rng_bounded(&game->rng, free_count));
+	}
+
+	/* The snake covers at most half of a sparse board, so a few draws find a free cell */
+	const uint32_t cols = (uint32_t)(shape.width - 3);
+	while (1) {
+		uint32_t cell = rng_bounded(&game->rng, play_area(&game->config));
+		cord_t food = { (short)(2 + cell / cols), (short)(2 + cell % cols) };
+		if (!cell_set_has(&game->body, cell_index(shape.width, &food)))
+			return food;
+	}
+}
+
+always_inline unsigned char check_over(game_t *restrict game, shape_t shape)
+{
+	if (snake_len(game, shape) == game->config.win_size)
+		return GAME_WON;
+
+	return game->head_blocked ? GAME_LOST : GAME_RUNNING;
+}
+
+always_inline unsigned char find_opposite(unsigned char direction)
+{
+	switch (direction) {
+		case UP_KEY:
+			return DOWN_KEY;
+		case DOWN_KEY:
+			return UP_KEY;
+		case LEFT_KEY:
+			return RIGHT_KEY;
+		case RIGHT_KEY:
+			return LEFT_KEY;
+		default:
+			return 0;
+	}
+}
+
+const char *game_config_error(const game_config_t *restrict config)
+{
+	if (config->width <= 8)
+		return "the board must be wider than 8";
+	if (config->height <= 8)
+		return "the board must be higher than 8";
+	if (config->win_size <= 3 || config->win_size >= play_area(config))
+		return "the winning length must be between 4 and the play area";
+	/* Food is drawn until it misses the snake, at most half of the board takes 2 draws */
+	if ((uint32_t)config->height * (uint32_t)config->width > GAME_DENSE_CELLS &&
+		config->win_size > play_area(config) / 2)
+		return "the winning length must be at most half the play area on a board this large";
+	return NULL;
+}
+
+void game_init(game_t *restrict game, uint64_t seed)
+{
+	game_init_config(game, &game_default_config, seed);
+}
+
+void game_init_config(game_t *restrict game,
+	const game_config_t *restrict config, uint64_t seed)
+{
+	const cord_t initial_snake_cords[3] = {
+		{ config->height / 2, config->width / 2 + 1 },
+		{ config->height / 2, config->width / 2 },
+		{ config->height / 2, config->width / 2 - 1 }
+	};
+
+	game->seed = seed;
+	rng_seed(&game->rng, seed, 0);
+	game->direction = LEFT_KEY;
+	game->over_type = GAME_RUNNING;
+	game->tick = 0;
+	game->ate_food = 0;
+	game->head_blocked = 0;
+
+	board_init(game, config, initial_snake_cords[0]);
+	if (game->sparse) {
+		for (size_t i = 0; i < sizeof(initial_snake_cords) / sizeof(cord_t); ++i) {
+			if (i > 0)
+				packed_body_push(&game->packed, initial_snake_cords[i]);
+			cell_set_insert(&game->body, cell_index(config->width, &initial_snake_cords[i]));
+		}
+	} else {
+		blocked_reset(&game->blocked, config);
+		for (size_t i = 0; i < sizeof(initial_snake_cords) / sizeof(cord_t); ++i) {
+			cord_queue_push(&game->snake, initial_snake_cords[i]);
+			bitboard_set(&game->blocked, initial_snake_cords[i].y, initial_snake_cords[i].x);
+		}
+		bitboard_counts_reset(&game->free_counts, &game->blocked);
+	}
+
+	game->tail = initial_snake_cords[0];
+	game->food = gen_food(game, game_shape(game));
+}
+
+int game_can_turn(const game_t *restrict game, unsigned char key)
+{
+	return (key == UP_KEY || key == DOWN_KEY || key == LEFT_KEY || key == RIGHT_KEY) &&
+		key != find_opposite(game->direction) && key != game->direction;
+}
+
+/* One step, the shape folds into constants when it is built from them,
+ * only the steps built with profiled true feed the probes
+ */
+always_inline unsigned char step(game_t *restrict game, shape_t shape, unsigned char input,
+	const int profiled)
+{
+	if (game->over_type != GAME_RUNNING)
+		return game->over_type;
+
+#ifdef SNAKE_ALLOC_CHECK
+	unsigned long long heap_calls = queue_heap_calls();
+#endif
+
+	if (game_can_turn(game, input))
+		game->direction = input;
+
+	cord_t head_node = snake_head(game, shape);
+	switch (game->direction) {
+		case UP_KEY:
+			head_node.y -= 1;
+			break;
+		case DOWN_KEY:
+			head_node.y += 1;
+			break;
+		case RIGHT_KEY:
+			head_node.x += 1;
+			break;
+		case LEFT_KEY:
+			head_node.x -= 1;
+			break;
+	}
+
+	/* Keep the tail if the snake ate the food */
+	game->ate_food = memcmp(&game->food, &head_node, sizeof(cord_t)) == 0;
+	if (!game->ate_food)
+		game->tail = snake_pop_tail(game, shape);
+
+	snake_push_head(game, shape, &head_node);
+
+	/* New food must be placed after the head is on the board */
+	if (game->ate_food) {
+		PROFILE_BEGIN_IF(profiled, food_start);
+		game->food = gen_food(game, shape);
+		PROFILE_END_IF(profiled, PROFILE_GEN_FOOD, food_start);
+	}
+
+	++game->tick;
+	PROFILE_BEGIN_IF(profiled, over_start);
+	game->over_type = check_over(game, shape);
+	PROFILE_END_IF(profiled, PROFILE_CHECK_OVER, over_start);
+
+#ifdef SNAKE_ALLOC_CHECK
+	/* The snake holds a winning snake from the start, so a step never allocates,
+	 * every structure of the engine allocates through queue_default_allocator
+	 */
+	assert(queue_heap_calls() == heap_calls);
+#endif
+
+	return game->over_type;
+}
+
+/* The steps of the specialized board sizes */
+#define GAME_BOARD_STEP(w, h) \
+	static unsigned char step_##w##x##h(game_t *restrict game, unsigned char input) \
+	{ \
+		return step(game, SHAPE_OF(game, w, h), input, 0); \
+	}
+GAME_SPECIALIZED_BOARDS(GAME_BOARD_STEP)
+#undef GAME_BOARD_STEP
+
+#ifdef SNAKE_PROFILE
+#define GAME_BOARD_PROFILED_STEP(w, h) \
+	static unsigned char profiled_step_##w##x##h(game_t *restrict game, unsigned char input) \
+	{ \
+		return step(game, SHAPE_OF(game, w, h), input, 1); \
+	}
+GAME_SPECIALIZED_BOARDS(GAME_BOARD_PROFILED_STEP)
+#undef GAME_BOARD_PROFILED_STEP
+#endif
+
+unsigned char game_step(game_t *restrict game, unsigned char input)
+{
+	switch (game->board_kind) {
+#define GAME_BOARD_CASE(w, h) \
+		case GAME_BOARD_##w##x##h: \
+			return step_##w##x##h(game, input);
+		GAME_SPECIALIZED_BOARDS(GAME_BOARD_CASE)
+#undef GAME_BOARD_CASE
+		default:
+			return game_step_generic(game, input);
+	}
+}
+
+unsigned char game_step_generic(game_t *restrict game, unsigned char input)
+{
+	return step(game, game_shape(game), input, 0);
+}
+
+#ifdef SNAKE_PROFILE
+unsigned char game_step_profiled(game_t *restrict game, unsigned char input)
+{
+	switch (game->board_kind) {
+#define GAME_BOARD_CASE(w, h) \
+		case GAME_BOARD_##w##x##h: \
+			return profiled_step_##w##x##h(game, input);
+		GAME_SPECIALIZED_BOARDS(GAME_BOARD_CASE)
+#undef GAME_BOARD_CASE
+		default:
+			return step(game, game_shape(game), input, 1);
+	}
+}
+#endif
+
+void game_copy(game_t *restrict dst, game_t *restrict src)
+{
+	/* The snake and its board are only reallocated when the config changes */
+	if (memcmp(&dst->config, &src->config, sizeof(game_config_t)) != 0) {
+		game_destory(dst);
+		board_init(dst, &src->config, game_snake_tail(src));
+	}
+
+	cord_queue_t snake = dst->snake;
+	packed_body_t packed = dst->packed;
+	bitboard_t blocked = dst->blocked;
+	bitboard_counts_t free_counts = dst->free_counts;
+	cell_set_t body = dst->body;
+
+	*dst = *src;
+	dst->snake = snake;
+	dst->packed = packed;
+	dst->blocked = blocked;
+	dst->free_counts = free_counts;
+	dst->body = body;
+	if (src->sparse) {
+		packed_body_copy(&dst->packed, &src->packed);
+		cell_set_copy(&dst->body, &src->body);
+	} else {
+		cord_queue_copy(&dst->snake, &src->snake);
+		bitboard_copy(&dst->blocked, &src->blocked);
+		bitboard_counts_copy(&dst->free_counts, &src->free_counts);
+	}
+}
+
+void game_push_head(game_t *restrict game, const cord_t *restrict head_node)
+{
+	snake_push_head(game, game_shape(game), head_node);
+}
+
+cord_t game_pop_tail(game_t *restrict game)
+{
+	return snake_pop_tail(game, game_shape(game));
+}
+
+cord_t game_gen_food(game_t *restrict game)
+{
+	return gen_food(game, game_shape(game));
+}
+
+unsigned char game_check_over(game_t *restrict game)
+{
+	return check_over(game, game_shape(game));
+}
@@ -0,0 +1,320 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Headless snake game engine, it never touches the terminal
+ */
+#ifndef __SNAKE_ENGINE_H__
+#define __SNAKE_ENGINE_H__
+
+#include "common-def.h"
+#include "bitboard.h"
+#include "body.h"
+#include "cellset.h"
+#include "queue.h"
+#include "rng.h"
+#include "snake.h"
+
+enum { GAME_RUNNING, GAME_LOST, GAME_WON };
+
+/* Boards with up to this many cells block everything on a bitboard, larger ones
+ * only keep the snake in a hash set, so nothing is sized by the board area
+ */
+#define GAME_DENSE_CELLS (1U << 16)
+
+/* Board sizes whose step is compiled with the size as a constant, X(width, height) */
+#define GAME_SPECIALIZED_BOARDS(X) \
+	X(64, 16) \
+	X(64, 64) \
+	X(128, 128)
+
+/* Which step a game takes, any other size takes the generic one */
+enum {
+	GAME_BOARD_GENERIC,
+#define GAME_BOARD_ENUM(w, h) GAME_BOARD_##w##x##h,
+	GAME_SPECIALIZED_BOARDS(GAME_BOARD_ENUM)
+#undef GAME_BOARD_ENUM
+};
+
+/* Queue of snake segments from the tail to the head */
+QUEUE_DEFINE(cord_queue, cord_t)
+
+/* Board config struct, the macros of snake.h are the defaults */
+typedef struct {
+	short width;
+	short height;
+	/* Length of the snake which wins the game */
+	unsigned int win_size;
+} game_config_t;
+
+/* Game state struct */
+typedef struct {
+	game_config_t config;
+	/* Segments from the tail to the head, packed on sparse boards */
+	cord_queue_t snake;
+	packed_body_t packed;
+	cord_t food;
+	/* The cell the tail left in the last step */
+	cord_t tail;
+	/* Number of steps taken so far */
+	uint64_t tick;
+	unsigned char direction;
+	unsigned char over_type;
+	unsigned char ate_food;
+	/* Whether the last head was put on a blocked cell */
+	unsigned char head_blocked;
+	/* 1 if the snake is kept in packed and body, 0 if in snake and blocked */
+	unsigned char sparse;
+	/* GAME_BOARD_GENERIC or the specialized size of the board */
+	unsigned char board_kind;
+	/* Walls, cells outside the play area and the snake, food goes on the clear bits */
+	bitboard_t blocked;
+	bitboard_counts_t free_counts;
+	/* Cell indexes of the snake, the walls are checked by their coordinates */
+	cell_set_t body;
+	/* The seed replays the game together with the inputs */
+	uint64_t seed;
+	rng_t rng;
+} game_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The default 64x16 board */
+extern const game_config_t game_default_config;
+
+/* Check whether a board config can be played
+ *
+ * Parameters:
+ * config: pointer to a board config
+ *
+ * Return:
+ * NULL if it is valid, otherwise what is wrong with it
+ *
+ * Note: Boards of more than GAME_DENSE_CELLS cells take a winning length of
+ *	   at most half their play area
+ */
+extern const char *game_config_error(const game_config_t *restrict config);
+
+/* Initialize a game on the default board with the initial snake and food
+ *
+ * Parameters:
+ * game: pointer to a game
+ * seed: seed of the random numbers of this game
+ *
+ * Return:
+ * None
+ *
+ * Note: The same seed and inputs always give the same game
+ */
+extern void game_init(game_t *restrict game, uint64_t seed);
+
+/* Initialize a game on any board with the initial snake and food
+ *
+ * Parameters:
+ * game: pointer to a game
+ * config: pointer to a valid board config
+ * seed: seed of the random numbers of this game
+ *
+ * Return:
+ * None
+ *
+ * Note: Memory and the cost of a step only grow with win_size,
+ *	   except on boards of at most GAME_DENSE_CELLS cells
+ */
+extern void game_init_config(game_t *restrict game,
+	const game_config_t *restrict config, uint64_t seed);
+
+/* Check whether a key turns the snake
+ *
+ * Parameters:
+ * game: pointer to a game
+ * key: the key pressed by the player
+ *
+ * Return:
+ * 1 if the key is a direction other than the current one or its opposite,
+ * 0 otherwise
+ */
+extern int game_can_turn(const game_t *restrict game, unsigned char key);
+
+/* Advance the game by one step
+ *
+ * Parameters:
+ * game: pointer to a game
+ * input: the key pressed by the player, or 0 if there is none
+ *
+ * Return:
+ * GAME_RUNNING, GAME_LOST or GAME_WON
+ *
+ * Note: After the step, ate_food tells whether the snake grew,
+ *	   otherwise tail holds the cell which has been vacated,
+ *	   the boards of GAME_SPECIALIZED_BOARDS take their own faster step
+ */
+extern unsigned char game_step(game_t *restrict game, unsigned char input);
+
+/* Advance the game by one step without the board size specializations
+ *
+ * Parameters:
+ * game: pointer to a game
+ * input: the key pressed by the player, or 0 if there is none
+ *
+ * Return:
+ * GAME_RUNNING, GAME_LOST or GAME_WON
+ *
+ * Note: Same result as game_step, it is there to benchmark and check it
+ */
+extern unsigned char game_step_generic(game_t *restrict game, unsigned char input);
+
+#ifdef SNAKE_PROFILE
+/* Advance the game by one step and time check_over and gen_food
+ *
+ * Parameters:
+ * game: pointer to a game
+ * input: the key pressed by the player, or 0 if there is none
+ *
+ * Return:
+ * GAME_RUNNING, GAME_LOST or GAME_WON
+ *
+ * Note: Same result as game_step, only the game on screen should take it,
+ *	   so the simulations of the bots stay out of the histograms
+ */
+extern unsigned char game_step_profiled(game_t *restrict game, unsigned char input);
+#endif
+
+/* Copy the whole state of a game into another one
+ *
+ * Parameters:
+ * dst: pointer to an initialized game to overwrite
+ * src: pointer to the game to copy
+ *
+ * Return:
+ * None
+ *
+ * Note: Cheap enough to snapshot and restore a game for every simulation,
+ *	   nothing is allocated once dst has played a game of the same config
+ */
+extern void game_copy(game_t *restrict dst, game_t *restrict src);
+
+/* Get the number of segments of the snake */
+always_inline size_t game_snake_len(const game_t *restrict game)
+{
+	return game->sparse ? packed_body_len(&game->packed) : cord_queue_len(&game->snake);
+}
+
+/* Get a segment of the snake
+ *
+ * Parameters:
+ * game: pointer to a game
+ * index: index of the segment from the tail, less than game_snake_len()
+ *
+ * Return:
+ * The cell of the segment
+ *
+ * Note: O(1), but a packed snake walks up to PACKED_BODY_CHECKPOINT moves
+ */
+always_inline cord_t game_snake_get(const game_t *restrict game, size_t index)
+{
+	return game->sparse ? packed_body_get(&game->packed, index) :
+		*cord_queue_get_item(&game->snake, index);
+}
+
+always_inline cord_t game_snake_head(const game_t *restrict game)
+{
+	return game->sparse ? game->packed.head : *cord_queue_back(&game->snake);
+}
+
+always_inline cord_t game_snake_tail(const game_t *restrict game)
+{
+	return game->sparse ? game->packed.tail : *cord_queue_front(&game->snake);
+}
+
+/* Check whether the snake or a wall is on a cell
+ *
+ * Parameters:
+ * game: pointer to a game
+ * y: row of the cell
+ * x: column of the cell, the cell must be on the board
+ *
+ * Return:
+ * 1 if the cell is blocked, 0 otherwise
+ */
+always_inline int game_cell_blocked(const game_t *restrict game, short y, short x)
+{
+	if (!game->sparse)
+		return bitboard_test(&game->blocked, y, x);
+
+	return y <= 1 || x <= 1 || y >= game->config.height - 1 || x >= game->config.width - 1 ||
+		cell_set_has(&game->body, (uint32_t)y * (uint32_t)game->config.width + (uint32_t)x);
+}
+
+/* Put a new head on the snake, keeping the board in sync
+ *
+ * Parameters:
+ * game: pointer to a game
+ * head_node: the cell of the new head
+ *
+ * Return:
+ * None
+ *
+ * Note: The board is only exact while the head has not hit anything,
+ *	   which ends the game anyway
+ */
+extern void game_push_head(game_t *restrict game, const cord_t *restrict head_node);
+
+/* Remove the tail of the snake, keeping the board in sync
+ *
+ * Parameters:
+ * game: pointer to a game
+ *
+ * Return:
+ * The cell the tail left
+ *
+ * Note: A packed snake must keep at least its head
+ */
+extern cord_t game_pop_tail(game_t *restrict game);
+
+/* Pick a random free cell for the food
+ *
+ * Parameters:
+ * game: pointer to a game
+ *
+ * Return:
+ * The cell, the game itself is not changed except for its random state
+ */
+extern cord_t game_gen_food(game_t *restrict game);
+
+/* Check whether the game is over with the current snake
+ *
+ * Parameters:
+ * game: pointer to a game
+ *
+ * Return:
+ * GAME_RUNNING, GAME_LOST or GAME_WON
+ */
+extern unsigned char game_check_over(game_t *restrict game);
+
+/* Destory a game
+ *
+ * Parameters:
+ * game: pointer to a game
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it to prevent memory leak
+ */
+always_inline void game_destory(game_t *restrict game)
+{
+	if (game->sparse) {
+		packed_body_destory(&game->packed);
+		cell_set_destory(&game->body);
+	} else {
+		cord_queue_destory(&game->snake);
+		bitboard_destory(&game->blocked);
+		bitboard_counts_destory(&game->free_counts);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,716 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "match.h"
+
+/* Random spots tried for a new snake before giving up */
+#define SPAWN_TRIES 64
+/* Random cells tried for one food before waiting for the next step */
+#define FOOD_TRIES 16
+
+static const unsigned char move_keys[4] = { UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY };
+static const short move_dy[4] = { -1, 1, 0, 0 };
+static const short move_dx[4] = { 0, 0, -1, 1 };
+
+/* Frame reader, bad is set once anything is read past the end */
+typedef struct {
+	const unsigned char *pos;
+	const unsigned char *end;
+	int bad;
+} reader_t;
+
+always_inline unsigned char move_code(unsigned char key)
+{
+	switch (key) {
+		case UP_KEY:
+			return 0;
+		case DOWN_KEY:
+			return 1;
+		case LEFT_KEY:
+			return 2;
+		default:
+			return 3;
+	}
+}
+
+/* Move between two neighbouring cells */
+always_inline unsigned char move_between(cord_t from, cord_t to)
+{
+	if (to.y != from.y)
+		return to.y < from.y ? 0 : 1;
+	return to.x < from.x ? 2 : 3;
+}
+
+always_inline int key_turns(unsigned char direction, unsigned char key)
+{
+	if (key != UP_KEY && key != DOWN_KEY && key != LEFT_KEY && key != RIGHT_KEY)
+		return 0;
+
+	/* Opposite moves only differ in their lowest bit */
+	return key != direction && (move_code(key) ^ 1) != move_code(direction);
+}
+
+always_inline uint32_t cell_of(const match_t *restrict match, cord_t cord)
+{
+	return (uint32_t)cord.y * (uint32_t)match->config.width + (uint32_t)cord.x;
+}
+
+always_inline cord_t cord_of(const match_t *restrict match, uint32_t cell)
+{
+	return (cord_t){ (short)(cell / (uint32_t)match->config.width),
+		(short)(cell % (uint32_t)match->config.width) };
+}
+
+always_inline int in_play_area(const match_t *restrict match, cord_t cord)
+{
+	return cord.y >= 2 && cord.x >= 2 &&
+		cord.y <= match->config.height - 2 && cord.x <= match->config.width - 2;
+}
+
+static void buffer_reserve(match_buffer_t *restrict buffer, size_t extra)
+{
+	if (buffer->len + extra <= buffer->capacity)
+		return;
+
+	size_t capacity = buffer->capacity != 0 ? buffer->capacity : 256;
+	while (capacity < buffer->len + extra)
+		capacity <<= 1;
+
+	unsigned char *data = (unsigned char *)realloc(buffer->data, capacity);
+	if (data == NULL) {
+		fputs("Match->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	buffer->data = data;
+	buffer->capacity = capacity;
+}
+
+void match_buffer_put(match_buffer_t *restrict buffer, const void *restrict data, size_t len)
+{
+	buffer_reserve(buffer, len);
+	memcpy(buffer->data + buffer->len, data, len);
+	buffer->len += len;
+}
+
+always_inline void put_byte(match_buffer_t *restrict buffer, unsigned char value)
+{
+	buffer_reserve(buffer, 1);
+	buffer->data[buffer->len++] = value;
+}
+
+always_inline void put_varint(match_buffer_t *restrict buffer, uint64_t value)
+{
+	buffer_reserve(buffer, 10);
+	while (value >= 0x80) {
+		buffer->data[buffer->len++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	buffer->data[buffer->len++] = (unsigned char)value;
+}
+
+/* Start a frame, its length is filled in by frame_end */
+always_inline size_t frame_begin(match_buffer_t *restrict buffer, unsigned char type)
+{
+	size_t start = buffer->len;
+	buffer_reserve(buffer, 5);
+	buffer->len += 4;
+	buffer->data[buffer->len++] = type;
+	return start;
+}
+
+always_inline void frame_end(match_buffer_t *restrict buffer, size_t start)
+{
+	size_t len = buffer->len - start - 4;
+	for (int i = 0; i < 4; ++i)
+		buffer->data[start + i] = (unsigned char)(len >> (8 * i));
+}
+
+always_inline unsigned char get_byte(reader_t *restrict reader)
+{
+	if (reader->pos >= reader->end) {
+		reader->bad = 1;
+		return 0;
+	}
+	return *reader->pos++;
+}
+
+always_inline uint64_t get_varint(reader_t *restrict reader)
+{
+	uint64_t value = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		unsigned char byte = get_byte(reader);
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	reader->bad = 1;
+	return 0;
+}
+
+/* Encode a snake, its moves are packed four to a byte */
+static void put_snake(const match_t *restrict match, unsigned int id,
+	match_buffer_t *restrict buffer)
+{
+	const match_player_t *player = &match->players[id];
+	size_t len = cord_queue_len(&player->snake);
+
+	put_varint(buffer, id);
+	put_byte(buffer, move_code(player->direction));
+	put_varint(buffer, len);
+	put_varint(buffer, cell_of(match, *cord_queue_front(&player->snake)));
+
+	unsigned char packed = 0;
+	for (size_t i = 1; i < len; ++i) {
+		packed |= move_between(*cord_queue_get_item(&player->snake, i - 1),
+			*cord_queue_get_item(&player->snake, i)) << (i - 1) % 4 * 2;
+		if (i % 4 == 0 || i == len - 1) {
+			put_byte(buffer, packed);
+			packed = 0;
+		}
+	}
+}
+
+/* Give a snake its cells, they must all be free */
+always_inline void place_head(match_t *restrict match, match_player_t *restrict player, cord_t cell)
+{
+	cord_queue_push(&player->snake, cell);
+	bitboard_set(&match->blocked, cell.y, cell.x);
+}
+
+/* Take a snake off the board */
+static void clear_snake(match_t *restrict match, match_player_t *restrict player)
+{
+	while (cord_queue_len(&player->snake) > 0) {
+		cord_t cell = cord_queue_pop(&player->snake);
+		bitboard_clear(&match->blocked, cell.y, cell.x);
+	}
+	player->state = MATCH_SLOT_DEAD;
+	--match->alive_num;
+}
+
+/* Take a snake off the board and tell the clients how it ended */
+static void end_snake(match_t *restrict match, unsigned int id, match_buffer_t *restrict buffer)
+{
+	clear_snake(match, &match->players[id]);
+	put_byte(buffer, MATCH_RECORD_END);
+	put_varint(buffer, id);
+	put_byte(buffer, match->players[id].result);
+}
+
+always_inline void bring_alive(match_t *restrict match, match_player_t *restrict player,
+	unsigned char direction)
+{
+	player->state = MATCH_SLOT_ALIVE;
+	player->direction = direction;
+	player->input = 0;
+	player->result = GAME_RUNNING;
+	++match->alive_num;
+}
+
+/* Decode a snake and put it on the board */
+static void get_snake(match_t *restrict match, reader_t *restrict reader)
+{
+	uint64_t id = get_varint(reader);
+	unsigned char code = get_byte(reader);
+	uint64_t len = get_varint(reader);
+	uint64_t tail = get_varint(reader);
+
+	if (reader->bad || id >= match->max_players || code > 3 || len == 0 ||
+			len > match->config.win_size || match->players[id].state == MATCH_SLOT_ALIVE ||
+			tail >= (uint64_t)match->config.height * (uint64_t)match->config.width) {
+		reader->bad = 1;
+		return;
+	}
+
+	match_player_t *player = &match->players[id];
+	cord_t cell = cord_of(match, (uint32_t)tail);
+	bring_alive(match, player, move_keys[code]);
+
+	unsigned char packed = 0;
+	for (uint64_t i = 0; i < len; ++i) {
+		if (i > 0) {
+			if ((i - 1) % 4 == 0)
+				packed = get_byte(reader);
+			unsigned char move = packed >> (i - 1) % 4 * 2 & 3;
+			cell = (cord_t){ cell.y + move_dy[move], cell.x + move_dx[move] };
+		}
+
+		if (reader->bad || !in_play_area(match, cell) ||
+				bitboard_test(&match->blocked, cell.y, cell.x)) {
+			reader->bad = 1;
+			clear_snake(match, player);
+			return;
+		}
+		place_head(match, player, cell);
+	}
+}
+
+always_inline int cell_free(const match_t *restrict match, cord_t cell)
+{
+	return !bitboard_test(&match->blocked, cell.y, cell.x) &&
+		!cell_set_has(&match->food, cell_of(match, cell));
+}
+
+/* Put a new snake of three cells on a free spot, with two free cells ahead */
+static int spawn(match_t *restrict match, unsigned int id)
+{
+	match_player_t *player = &match->players[id];
+
+	for (int try = 0; try < SPAWN_TRIES; ++try) {
+		unsigned char move = (unsigned char)rng_bounded(&match->rng, 4);
+		cord_t head = {
+			(short)(4 + rng_bounded(&match->rng, (uint32_t)(match->config.height - 7))),
+			(short)(4 + rng_bounded(&match->rng, (uint32_t)(match->config.width - 7)))
+		};
+
+		int room = 1;
+		for (short i = -2; i <= 2 && room; ++i)
+			room = cell_free(match, (cord_t){ head.y + i * move_dy[move], head.x + i * move_dx[move] });
+		if (!room)
+			continue;
+
+		bring_alive(match, player, move_keys[move]);
+		for (short i = -2; i <= 0; ++i)
+			place_head(match, player, (cord_t){ head.y + i * move_dy[move], head.x + i * move_dx[move] });
+
+		put_byte(&match->pending, MATCH_RECORD_SPAWN);
+		put_snake(match, id, &match->pending);
+		return 0;
+	}
+
+	return -1;
+}
+
+/* Top the food up, what cannot be placed now is tried again next step */
+static void refill_food(match_t *restrict match, match_buffer_t *restrict buffer)
+{
+	const uint32_t cols = (uint32_t)(match->config.width - 3);
+	const uint32_t cells = (uint32_t)(match->config.height - 3) * cols;
+
+	while (match->food_num < match->foods) {
+		int placed = 0;
+		for (int try = 0; try < FOOD_TRIES && !placed; ++try) {
+			uint32_t index = rng_bounded(&match->rng, cells);
+			cord_t food = { (short)(2 + index / cols), (short)(2 + index % cols) };
+			if (cell_free(match, food)) {
+				cell_set_insert(&match->food, cell_of(match, food));
+				put_byte(buffer, MATCH_RECORD_FOOD);
+				put_varint(buffer, cell_of(match, food));
+				++match->food_num;
+				placed = 1;
+			}
+		}
+
+		if (!placed)
+			return;
+	}
+}
+
+const char *match_config_error(const game_config_t *restrict config,
+	unsigned int max_players, unsigned int foods)
+{
+	const char *error = game_config_error(config);
+	if (error != NULL)
+		return error;
+	if ((uint32_t)config->height * (uint32_t)config->width > MATCH_MAX_CELLS)
+		return "the board of a match must have at most 16M cells";
+	if (max_players == 0 || max_players > MATCH_MAX_PLAYERS)
+		return "a match must have between 1 and 4096 players";
+	if (foods == 0 || foods > (uint32_t)(config->height - 3) * (uint32_t)(config->width - 3) / 4)
+		return "the food must be between 1 and a quarter of the play area";
+	return NULL;
+}
+
+void match_init(match_t *restrict match, const game_config_t *restrict config,
+	unsigned int max_players, unsigned int foods, uint64_t seed)
+{
+	match->config = *config;
+	match->max_players = max_players;
+	match->foods = foods;
+	match->food_num = 0;
+	match->tick = 0;
+	match->alive_num = 0;
+	rng_seed(&match->rng, seed, 0);
+	memset(&match->pending, 0, sizeof(match_buffer_t));
+	memset(&match->frame, 0, sizeof(match_buffer_t));
+
+	if ((match->players = (match_player_t *)calloc(max_players, sizeof(match_player_t))) == NULL) {
+		fputs("Match->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+	for (unsigned int i = 0; i < max_players; ++i)
+		cord_queue_init(&match->players[i].snake, config->win_size);
+
+	/* Only the play area is clear */
+	bitboard_init(&match->blocked, config->height, config->width);
+	for (short i = 2; i < config->height - 1; ++i) {
+		for (short j = 2; j < config->width - 1; ++j)
+			bitboard_clear(&match->blocked, i, j);
+	}
+
+	cell_set_init(&match->food, foods);
+	cell_set_init(&match->heads, max_players);
+	cell_set_init(&match->clashes, max_players);
+	refill_food(match, &match->pending);
+}
+
+int match_join(match_t *restrict match)
+{
+	for (unsigned int id = 0; id < match->max_players; ++id) {
+		if (match->players[id].state == MATCH_SLOT_FREE)
+			return spawn(match, id) == 0 ? (int)id : -1;
+	}
+	return -1;
+}
+
+int match_respawn(match_t *restrict match, unsigned int id)
+{
+	return match->players[id].state == MATCH_SLOT_DEAD ? spawn(match, id) : -1;
+}
+
+void match_leave(match_t *restrict match, unsigned int id)
+{
+	match_player_t *player = &match->players[id];
+
+	if (player->state == MATCH_SLOT_ALIVE) {
+		player->result = GAME_LOST;
+		end_snake(match, id, &match->pending);
+	}
+	player->state = MATCH_SLOT_FREE;
+}
+
+void match_input(match_t *restrict match, unsigned int id, unsigned char key)
+{
+	match_player_t *player = &match->players[id];
+	if (player->state == MATCH_SLOT_ALIVE && player->input == 0 &&
+			key_turns(player->direction, key))
+		player->input = key;
+}
+
+void match_step(match_t *restrict match)
+{
+	match_buffer_t *frame = &match->frame;
+	unsigned int survivors = 0;
+
+	frame->len = 0;
+	size_t start = frame_begin(frame, MATCH_FRAME_DELTA);
+	put_varint(frame, ++match->tick);
+	match_buffer_put(frame, match->pending.data, match->pending.len);
+	match->pending.len = 0;
+
+	/* Every snake turns and moves its head, the tails of those not eating leave first */
+	for (unsigned int id = 0; id < match->max_players; ++id) {
+		match_player_t *player = &match->players[id];
+		if (player->state != MATCH_SLOT_ALIVE)
+			continue;
+
+		if (player->input != 0) {
+			player->direction = player->input;
+			player->input = 0;
+		}
+
+		unsigned char move = move_code(player->direction);
+		cord_t head = *cord_queue_back(&player->snake);
+		player->next = (cord_t){ head.y + move_dy[move], head.x + move_dx[move] };
+		player->eats = cell_set_has(&match->food, cell_of(match, player->next));
+		if (!player->eats) {
+			cord_t tail = cord_queue_pop(&player->snake);
+			bitboard_clear(&match->blocked, tail.y, tail.x);
+		}
+
+		if (cell_set_insert(&match->heads, cell_of(match, player->next)))
+			cell_set_insert(&match->clashes, cell_of(match, player->next));
+	}
+
+	/* Then heads hit walls, bodies and other heads, all in one pass */
+	for (unsigned int id = 0; id < match->max_players; ++id) {
+		match_player_t *player = &match->players[id];
+		if (player->state != MATCH_SLOT_ALIVE)
+			continue;
+
+		uint32_t next = cell_of(match, player->next);
+		if (bitboard_test(&match->blocked, player->next.y, player->next.x) ||
+				cell_set_has(&match->clashes, next))
+			player->result = GAME_LOST;
+		else
+			++survivors;
+	}
+
+	/* The dead leave before the others move, clients then never see
+	 * a head on a cell whose tail has only left on the server
+	 */
+	for (unsigned int id = 0; id < match->max_players; ++id) {
+		match_player_t *player = &match->players[id];
+		if (player->state != MATCH_SLOT_ALIVE || player->result == GAME_RUNNING)
+			continue;
+
+		cell_set_remove(&match->heads, cell_of(match, player->next));
+		cell_set_remove(&match->clashes, cell_of(match, player->next));
+		end_snake(match, id, frame);
+	}
+
+	put_byte(frame, MATCH_RECORD_MOVES);
+	put_varint(frame, survivors);
+	for (unsigned int id = 0; id < match->max_players; ++id) {
+		match_player_t *player = &match->players[id];
+		if (player->state != MATCH_SLOT_ALIVE)
+			continue;
+
+		uint32_t next = cell_of(match, player->next);
+		cell_set_remove(&match->heads, next);
+		cell_set_remove(&match->clashes, next);
+		place_head(match, player, player->next);
+		put_varint(frame, id);
+		put_byte(frame, move_code(player->direction) | player->eats << 2);
+
+		if (player->eats) {
+			cell_set_remove(&match->food, next);
+			--match->food_num;
+			if (cord_queue_len(&player->snake) == match->config.win_size)
+				player->result = GAME_WON;
+		}
+	}
+
+	/* Winners leave after their last move */
+	for (unsigned int id = 0; id < match->max_players; ++id) {
+		if (match->players[id].state == MATCH_SLOT_ALIVE &&
+				match->players[id].result == GAME_WON)
+			end_snake(match, id, frame);
+	}
+
+	refill_food(match, frame);
+	frame_end(frame, start);
+}
+
+void match_snapshot(const match_t *restrict match, unsigned int id,
+	match_buffer_t *restrict buffer)
+{
+	size_t start = frame_begin(buffer, MATCH_FRAME_SNAPSHOT);
+
+	put_varint(buffer, id);
+	put_varint(buffer, (uint64_t)match->config.width);
+	put_varint(buffer, (uint64_t)match->config.height);
+	put_varint(buffer, match->config.win_size);
+	put_varint(buffer, match->max_players);
+	put_varint(buffer, match->foods);
+	put_varint(buffer, match->tick);
+
+	put_varint(buffer, match->food_num);
+	for (uint32_t i = 0; i <= match->food.mask; ++i) {
+		if (match->food.slots[i] != 0)
+			put_varint(buffer, match->food.slots[i] - 1);
+	}
+
+	put_varint(buffer, match->alive_num);
+	for (unsigned int i = 0; i < match->max_players; ++i) {
+		if (match->players[i].state == MATCH_SLOT_ALIVE)
+			put_snake(match, i, buffer);
+	}
+
+	frame_end(buffer, start);
+}
+
+always_inline uint32_t get_cell(const match_t *restrict match, reader_t *restrict reader)
+{
+	uint64_t cell = get_varint(reader);
+	if (cell >= (uint64_t)match->config.height * (uint64_t)match->config.width ||
+			!in_play_area(match, cord_of(match, (uint32_t)cell))) {
+		reader->bad = 1;
+		return 0;
+	}
+	return (uint32_t)cell;
+}
+
+static void apply_snapshot(match_t *restrict match, reader_t *restrict reader,
+	unsigned int *restrict id)
+{
+	uint64_t player_id = get_varint(reader);
+	uint64_t width = get_varint(reader), height = get_varint(reader);
+	uint64_t win_size = get_varint(reader);
+	uint64_t max_players = get_varint(reader), foods = get_varint(reader);
+	uint64_t tick = get_varint(reader);
+
+	if (reader->bad || width > SHRT_MAX || height > SHRT_MAX || win_size > UINT32_MAX ||
+			max_players > MATCH_MAX_PLAYERS || foods > UINT32_MAX || player_id >= max_players) {
+		reader->bad = 1;
+		return;
+	}
+
+	game_config_t config = { (short)width, (short)height, (unsigned int)win_size };
+	if (match_config_error(&config, (unsigned int)max_players, (unsigned int)foods) != NULL) {
+		reader->bad = 1;
+		return;
+	}
+
+	match_destory(match);
+	match_init(match, &config, (unsigned int)max_players, (unsigned int)foods, 0);
+	match->pending.len = 0;
+	match->tick = tick;
+	if (id != NULL)
+		*id = (unsigned int)player_id;
+
+	/* The food of the empty match is replaced by the server's */
+	memset(match->food.slots, 0, sizeof(uint32_t) * ((size_t)match->food.mask + 1));
+	match->food_num = 0;
+	uint64_t food_num = get_varint(reader);
+	if (food_num > foods)
+		reader->bad = 1;
+	for (uint64_t i = 0; i < food_num && !reader->bad; ++i) {
+		uint32_t cell = get_cell(match, reader);
+		if (!reader->bad && cell_set_insert(&match->food, cell))
+			reader->bad = 1;
+		++match->food_num;
+	}
+
+	uint64_t snake_num = get_varint(reader);
+	for (uint64_t i = 0; i < snake_num && !reader->bad; ++i)
+		get_snake(match, reader);
+}
+
+/* Apply a moves record, every tail leaves before any head is placed like on the server */
+static void apply_moves(match_t *restrict match, reader_t *restrict reader)
+{
+	uint64_t count = get_varint(reader);
+	const unsigned char *moves = reader->pos;
+
+	for (int pass = 0; pass < 2; ++pass) {
+		reader->pos = moves;
+		for (uint64_t i = 0; i < count && !reader->bad; ++i) {
+			uint64_t id = get_varint(reader);
+			unsigned char code = get_byte(reader);
+			if (reader->bad || id >= match->max_players || code > 7 ||
+					match->players[id].state != MATCH_SLOT_ALIVE) {
+				reader->bad = 1;
+				return;
+			}
+
+			match_player_t *player = &match->players[id];
+			unsigned char move = code & 3, eats = code >> 2;
+			if (pass == 0) {
+				if (!eats) {
+					if (cord_queue_len(&player->snake) < 2) {
+						reader->bad = 1;
+						return;
+					}
+					cord_t tail = cord_queue_pop(&player->snake);
+					bitboard_clear(&match->blocked, tail.y, tail.x);
+				}
+				continue;
+			}
+
+			cord_t head = *cord_queue_back(&player->snake);
+			cord_t next = { head.y + move_dy[move], head.x + move_dx[move] };
+			if (!in_play_area(match, next) || bitboard_test(&match->blocked, next.y, next.x) ||
+					cord_queue_len(&player->snake) >= match->config.win_size) {
+				reader->bad = 1;
+				return;
+			}
+
+			player->direction = move_keys[move];
+			place_head(match, player, next);
+			if (eats) {
+				cell_set_remove(&match->food, cell_of(match, next));
+				--match->food_num;
+			}
+		}
+	}
+}
+
+int match_apply(match_t *restrict match, const unsigned char *restrict data,
+	size_t len, unsigned int *restrict id)
+{
+	reader_t reader = { data, data + len, 0 };
+	unsigned char type = get_byte(&reader);
+
+	if (type == MATCH_FRAME_SNAPSHOT) {
+		apply_snapshot(match, &reader, id);
+		return reader.bad ? -1 : 0;
+	}
+	if (type != MATCH_FRAME_DELTA || match->players == NULL)
+		return -1;
+
+	match->tick = get_varint(&reader);
+	while (!reader.bad && reader.pos < reader.end) {
+		switch (get_byte(&reader)) {
+			case MATCH_RECORD_SPAWN:
+				get_snake(match, &reader);
+				break;
+			case MATCH_RECORD_MOVES:
+				apply_moves(match, &reader);
+				break;
+			case MATCH_RECORD_END: {
+				uint64_t player_id = get_varint(&reader);
+				unsigned char result = get_byte(&reader);
+				if (reader.bad || player_id >= match->max_players ||
+						match->players[player_id].state != MATCH_SLOT_ALIVE) {
+					reader.bad = 1;
+					break;
+				}
+				match->players[player_id].result = result;
+				clear_snake(match, &match->players[player_id]);
+				break;
+			}
+			case MATCH_RECORD_FOOD: {
+				uint32_t cell = get_cell(match, &reader);
+				if (reader.bad || match->food_num == match->foods ||
+						cell_set_insert(&match->food, cell))
+					reader.bad = 1;
+				++match->food_num;
+				break;
+			}
+			default:
+				reader.bad = 1;
+		}
+	}
+
+	return reader.bad ? -1 : 0;
+}
+
+uint64_t match_checksum(const match_t *restrict match)
+{
+	/* FNV-1a over the board and the snakes, the food is summed since
+	 * its order in the set depends on when it was added
+	 */
+	uint64_t hash = 14695981039346656037ULL;
+	const size_t words = (size_t)match->blocked.words * match->blocked.height;
+
+	for (size_t i = 0; i < words; ++i)
+		hash = (hash ^ match->blocked.rows[i]) * 1099511628211ULL;
+
+	for (unsigned int i = 0; i < match->max_players; ++i) {
+		const match_player_t *player = &match->players[i];
+		if (player->state != MATCH_SLOT_ALIVE)
+			continue;
+
+		cord_t head = *cord_queue_back(&player->snake);
+		hash = (hash ^ i) * 1099511628211ULL;
+		hash = (hash ^ cord_queue_len(&player->snake)) * 1099511628211ULL;
+		hash = (hash ^ cell_of(match, head)) * 1099511628211ULL;
+	}
+
+	uint64_t food = 0;
+	for (uint32_t i = 0; i <= match->food.mask; ++i) {
+		if (match->food.slots[i] != 0)
+			food += (uint64_t)match->food.slots[i] * 0x9E3779B97F4A7C15ULL;
+	}
+
+	return (hash ^ food ^ match->tick) * 1099511628211ULL;
+}
+
+void match_destory(match_t *restrict match)
+{
+	for (unsigned int i = 0; i < match->max_players; ++i)
+		cord_queue_destory(&match->players[i].snake);
+	free(match->players);
+	bitboard_destory(&match->blocked);
+	cell_set_destory(&match->food);
+	cell_set_destory(&match->heads);
+	cell_set_destory(&match->clashes);
+	match_buffer_destory(&match->pending);
+	match_buffer_destory(&match->frame);
+	match->players = NULL;
+	match->max_players = 0;
+}
@@ -0,0 +1,256 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Multiplayer match, many snakes on one shared board stepped together.
+ * The server steps it and sends frames, every client applies them to its own copy
+ *
+ * Frame layout, a u32 (little endian) length of the rest of the frame, then:
+ * MATCH_FRAME_SNAPSHOT: player id, width, height, win_size, max players, foods,
+ *     tick, food count, food cells, snake count, snakes
+ * MATCH_FRAME_DELTA: tick, then records until the end of the frame
+ * Every number is a varint, a cell is its index y * width + x and a snake is
+ * its id, direction, length, tail cell and one move per segment towards the head
+ */
+#ifndef __SNAKE_MATCH_H__
+#define __SNAKE_MATCH_H__
+
+#include "common-def.h"
+#include "engine.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Most players of one match, ids have to fit in 16 bits */
+#define MATCH_MAX_PLAYERS 4096
+/* Boards of a match are always kept on a bitboard, so their area is limited */
+#define MATCH_MAX_CELLS (1U << 24)
+
+enum { MATCH_FRAME_SNAPSHOT = 'S', MATCH_FRAME_DELTA = 'D' };
+
+/* Records of a delta frame, applied in order
+ * MATCH_RECORD_SPAWN: a snake
+ * MATCH_RECORD_MOVES: count, then id and (move | ate << 2) of every moving snake
+ * MATCH_RECORD_END: id, GAME_LOST or GAME_WON, the snake leaves the board
+ * MATCH_RECORD_FOOD: a new food cell
+ */
+enum {
+	MATCH_RECORD_SPAWN = 's',
+	MATCH_RECORD_MOVES = 'm',
+	MATCH_RECORD_END = 'e',
+	MATCH_RECORD_FOOD = 'f'
+};
+
+enum { MATCH_SLOT_FREE, MATCH_SLOT_ALIVE, MATCH_SLOT_DEAD };
+
+/* Growable byte buffer of encoded frames */
+typedef struct {
+	unsigned char *data;
+	size_t len;
+	size_t capacity;
+} match_buffer_t;
+
+/* Player struct, a slot keeps its snake memory between lives */
+typedef struct {
+	cord_queue_t snake;
+	unsigned char state;
+	unsigned char direction;
+	/* The first key which turned the snake since the last step */
+	unsigned char input;
+	/* GAME_RUNNING while alive, then how the last life ended */
+	unsigned char result;
+	/* Where the head goes in the step being taken */
+	unsigned char eats;
+	cord_t next;
+} match_player_t;
+
+/* Match struct */
+typedef struct {
+	game_config_t config;
+	unsigned int max_players;
+	/* Food kept on the board */
+	unsigned int foods;
+	unsigned int food_num;
+	uint64_t tick;
+	match_player_t *players;
+	unsigned int alive_num;
+	/* Walls and every snake */
+	bitboard_t blocked;
+	cell_set_t food;
+	/* Heads of the step being taken, and those reached by more than one snake */
+	cell_set_t heads;
+	cell_set_t clashes;
+	rng_t rng;
+	/* Records of the next delta frame which happened between steps */
+	match_buffer_t pending;
+	/* The last delta frame */
+	match_buffer_t frame;
+} match_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Check whether a match can be played
+ *
+ * Parameters:
+ * config: pointer to a board config
+ * max_players: most snakes on the board at once
+ * foods: food kept on the board
+ *
+ * Return:
+ * NULL if it is valid, otherwise what is wrong with it
+ */
+extern const char *match_config_error(const game_config_t *restrict config,
+	unsigned int max_players, unsigned int foods);
+
+/* Initialize an empty match
+ *
+ * Parameters:
+ * match: pointer to a match
+ * config: pointer to a valid board config, a snake of win_size wins
+ * max_players: most snakes on the board at once
+ * foods: food kept on the board
+ * seed: seed of the spawns and the food
+ *
+ * Return:
+ * None
+ *
+ * Note: Everything is allocated here, a step never allocates except for
+ *	   growing the frame buffers to their largest size
+ */
+extern void match_init(match_t *restrict match, const game_config_t *restrict config,
+	unsigned int max_players, unsigned int foods, uint64_t seed);
+
+/* Add a player and spawn its snake
+ *
+ * Parameters:
+ * match: pointer to a match
+ *
+ * Return:
+ * The player id, or -1 if the match is full
+ */
+extern int match_join(match_t *restrict match);
+
+/* Spawn the snake of a dead player again
+ *
+ * Parameters:
+ * match: pointer to a match
+ * id: a dead player
+ *
+ * Return:
+ * 0 on success, -1 if there is no room for the snake
+ */
+extern int match_respawn(match_t *restrict match, unsigned int id);
+
+/* Remove a player and its snake
+ *
+ * Parameters:
+ * match: pointer to a match
+ * id: a player
+ *
+ * Return:
+ * None
+ */
+extern void match_leave(match_t *restrict match, unsigned int id);
+
+/* Queue a key of a player for the next step
+ *
+ * Parameters:
+ * match: pointer to a match
+ * id: a player
+ * key: the key pressed by the player
+ *
+ * Return:
+ * None
+ *
+ * Note: Only the first key turning the snake counts, the others are dropped
+ */
+extern void match_input(match_t *restrict match, unsigned int id, unsigned char key);
+
+/* Move every snake one step and encode the delta frame
+ *
+ * Parameters:
+ * match: pointer to a match
+ *
+ * Return:
+ * None
+ *
+ * Note: Every tail leaves first, then every head is checked against the board
+ *	   and the other heads, so the cost grows with the players and not with
+ *	   their length, the frame is left in match->frame
+ */
+extern void match_step(match_t *restrict match);
+
+/* Encode the whole match for a new client
+ *
+ * Parameters:
+ * match: pointer to a match
+ * id: the player of the client
+ * buffer: the buffer to append the frame to
+ *
+ * Return:
+ * None
+ */
+extern void match_snapshot(const match_t *restrict match, unsigned int id,
+	match_buffer_t *restrict buffer);
+
+/* Apply a frame received from the server
+ *
+ * Parameters:
+ * match: pointer to a zeroed or initialized match
+ * data: the frame without its length
+ * len: length of the frame
+ * id: where to store the player id of a snapshot, it may be NULL
+ *
+ * Return:
+ * 0 on success, -1 if the frame is malformed
+ */
+extern int match_apply(match_t *restrict match, const unsigned char *restrict data,
+	size_t len, unsigned int *restrict id);
+
+/* Checksum of the board, the snakes and the food
+ *
+ * Parameters:
+ * match: pointer to a match
+ *
+ * Return:
+ * The same value for the same state, on the server and every client
+ */
+extern uint64_t match_checksum(const match_t *restrict match);
+
+/* Append bytes to a buffer
+ *
+ * Parameters:
+ * buffer: pointer to a buffer
+ * data: the bytes
+ * len: number of bytes
+ *
+ * Return:
+ * None
+ */
+extern void match_buffer_put(match_buffer_t *restrict buffer,
+	const void *restrict data, size_t len);
+
+always_inline void match_buffer_destory(match_buffer_t *restrict buffer)
+{
+	free(buffer->data);
+	buffer->data = NULL;
+	buffer->len = buffer->capacity = 0;
+}
+
+/* Destory a match
+ *
+ * Parameters:
+ * match: pointer to a match
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it to prevent memory leak
+ */
+extern void match_destory(match_t *restrict match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,380 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+
+#include "mcts.h"
+
+/* Deepest path the tree policy follows before a rollout */
+#define MCTS_MAX_DEPTH 256
+/* Rollouts between two looks at the clock */
+#define MCTS_CLOCK_INTERVAL 32
+/* Exploration constant of UCT */
+#define MCTS_EXPLORATION 0.25
+/* Value lost by every step taken before the first food */
+#define MCTS_FOOD_DISCOUNT 0.9
+
+enum { MOVE_STRAIGHT, MOVE_LEFT, MOVE_RIGHT };
+
+/* Key of a move relative to the current direction */
+always_inline unsigned char relative_key(const game_t *restrict game, unsigned int move)
+{
+	static const unsigned char turns[4][2] = {
+		{ LEFT_KEY, RIGHT_KEY },
+		{ RIGHT_KEY, LEFT_KEY },
+		{ DOWN_KEY, UP_KEY },
+		{ UP_KEY, DOWN_KEY }
+	};
+
+	unsigned int direction;
+	switch (game->direction) {
+		case UP_KEY:
+			direction = 0;
+			break;
+		case DOWN_KEY:
+			direction = 1;
+			break;
+		case LEFT_KEY:
+			direction = 2;
+			break;
+		default:
+			direction = 3;
+			break;
+	}
+
+	return move == MOVE_STRAIGHT ? game->direction : turns[direction][move - 1];
+}
+
+always_inline cord_t key_target(game_t *restrict game, unsigned char key)
+{
+	cord_t target = game_snake_head(game);
+	switch (key) {
+		case UP_KEY:
+			--target.y;
+			break;
+		case DOWN_KEY:
+			++target.y;
+			break;
+		case LEFT_KEY:
+			--target.x;
+			break;
+		case RIGHT_KEY:
+			++target.x;
+			break;
+	}
+	return target;
+}
+
+/* Safe move closest to the food most of the time, a random safe move otherwise */
+always_inline unsigned char rollout_policy(game_t *restrict game, rng_t *restrict rng)
+{
+	cord_t tail = game_snake_tail(game);
+	unsigned char safe[MCTS_MOVES], best = 0;
+	unsigned int safe_num = 0;
+	int best_dist = INT_MAX;
+
+	for (unsigned int move = 0; move < MCTS_MOVES; ++move) {
+		unsigned char key = relative_key(game, move);
+		cord_t target = key_target(game, key);
+		int eats = target.y == game->food.y && target.x == game->food.x;
+
+		/* The tail moves away unless the snake eats */
+		if (game_cell_blocked(game, target.y, target.x) &&
+				!(target.y == tail.y && target.x == tail.x && !eats))
+			continue;
+
+		safe[safe_num++] = key;
+		int dist = abs(game->food.y - target.y) + abs(game->food.x - target.x);
+		if (dist < best_dist) {
+			best = key;
+			best_dist = dist;
+		}
+	}
+
+	if (safe_num == 0)
+		return 0;
+	return rng_bounded(rng, 4) != 0 ? best : safe[rng_bounded(rng, safe_num)];
+}
+
+/* Winning is worth the most, then staying alive and eating soon, dying late beats dying early */
+always_inline double evaluate(game_t *restrict game, double food_value, unsigned int steps)
+{
+	if (game->over_type == GAME_WON)
+		return 1.0;
+	if (game->over_type == GAME_LOST)
+		return 0.25 * steps / (MCTS_MAX_DEPTH + MCTS_ROLLOUT_DEPTH);
+	return 0.5 + 0.5 * food_value;
+}
+
+/* Step the simulation, discounting the food until the snake eats */
+always_inline void sim_step(game_t *restrict sim, unsigned char key,
+	double *restrict food_value, unsigned int *restrict steps)
+{
+	game_step(sim, key);
+	if (*food_value < 0.0 && sim->ate_food)
+		*food_value = -*food_value;
+	else if (*food_value < 0.0)
+		*food_value *= MCTS_FOOD_DISCOUNT;
+	++*steps;
+}
+
+always_inline uint32_t select_child(const mcts_node_t *restrict nodes, uint32_t parent)
+{
+	const mcts_node_t *node = &nodes[parent];
+	double log_visits = log((double)node->visits);
+	double best_score = -1.0;
+	uint32_t best = 0;
+
+	for (unsigned int move = 0; move < MCTS_MOVES; ++move) {
+		const mcts_node_t *child = &nodes[node->children[move]];
+		double score = child->value / child->visits +
+			MCTS_EXPLORATION * sqrt(log_visits / child->visits);
+		if (score > best_score) {
+			best_score = score;
+			best = move;
+		}
+	}
+
+	return best;
+}
+
+/* One selection, expansion, rollout and backup */
+static void iterate(mcts_worker_t *restrict worker, game_t *restrict root)
+{
+	mcts_node_t *nodes = worker->nodes;
+	game_t *sim = &worker->sim;
+	uint32_t path[MCTS_MAX_DEPTH];
+	unsigned int depth = 0, steps = 0;
+
+	/* The food after the root is unknown, so every rollout draws its own */
+	game_copy(sim, root);
+	uint64_t food_seed = (uint64_t)rng_next(&worker->rng) << 32;
+	food_seed |= rng_next(&worker->rng);
+	rng_seed(&sim->rng, food_seed, 0);
+	/* Negative until the first food is eaten */
+	double food_value = -1.0;
+
+	uint32_t node = 0;
+	path[depth++] = node;
+	while (sim->over_type == GAME_RUNNING && depth < MCTS_MAX_DEPTH) {
+		unsigned int move;
+		for (move = 0; move < MCTS_MOVES && nodes[node].children[move] != 0; ++move)
+			;
+
+		/* Expand the first untried move, then roll out from the new node */
+		if (move < MCTS_MOVES) {
+			if (worker->node_count == MCTS_POOL_SIZE)
+				break;
+
+			uint32_t child = worker->node_count++;
+			nodes[child] = (mcts_node_t){ { 0, 0, 0 }, 0, 0.0 };
+			nodes[node].children[move] = child;
+
+			sim_step(sim, relative_key(sim, move), &food_value, &steps);
+			path[depth++] = child;
+			break;
+		}
+
+		move = select_child(nodes, node);
+		sim_step(sim, relative_key(sim, move), &food_value, &steps);
+		node = nodes[node].children[move];
+		path[depth++] = node;
+	}
+
+	for (unsigned int i = 0; i < MCTS_ROLLOUT_DEPTH && sim->over_type == GAME_RUNNING; ++i)
+		sim_step(sim, rollout_policy(sim, &worker->rng), &food_value, &steps);
+
+	double value = evaluate(sim, food_value > 0.0 ? food_value : 0.0, steps);
+	for (unsigned int i = 0; i < depth; ++i) {
+		++nodes[path[i]].visits;
+		nodes[path[i]].value += value;
+	}
+}
+
+always_inline int past_deadline(const struct timespec *restrict deadline)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec > deadline->tv_sec ||
+		(now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/* Build a fresh tree from the root of the current job */
+static void search(mcts_worker_t *restrict worker)
+{
+	mcts_t *mcts = worker->mcts;
+	unsigned long limit = mcts->max_rollouts == 0 ? ULONG_MAX :
+		(mcts->max_rollouts + mcts->worker_num - 1) / mcts->worker_num;
+
+	worker->nodes[0] = (mcts_node_t){ { 0, 0, 0 }, 0, 0.0 };
+	worker->node_count = 1;
+	worker->rollouts = 0;
+
+	while (worker->rollouts < limit) {
+		if (mcts->budget_ns != 0 && worker->rollouts % MCTS_CLOCK_INTERVAL == 0 &&
+				past_deadline(&mcts->deadline))
+			break;
+
+		iterate(worker, mcts->root);
+		++worker->rollouts;
+	}
+}
+
+static void *worker_main(void *arg)
+{
+	mcts_worker_t *worker = arg;
+	mcts_t *mcts = worker->mcts;
+	unsigned long job = 0;
+
+	pthread_mutex_lock(&mcts->lock);
+	while (1) {
+		while (mcts->job == job && !mcts->shutdown)
+			pthread_cond_wait(&mcts->job_ready, &mcts->lock);
+		if (mcts->shutdown)
+			break;
+
+		job = mcts->job;
+		pthread_mutex_unlock(&mcts->lock);
+
+		search(worker);
+
+		pthread_mutex_lock(&mcts->lock);
+		if (--mcts->busy == 0)
+			pthread_cond_signal(&mcts->job_done);
+	}
+	pthread_mutex_unlock(&mcts->lock);
+
+	return NULL;
+}
+
+void mcts_init(mcts_t *restrict mcts, unsigned int threads,
+	long budget_ms, unsigned long max_rollouts, uint64_t seed)
+{
+	mcts->worker_num = threads > 0 ? threads : 1;
+	mcts->budget_ns = (int64_t)(budget_ms == 0 && max_rollouts == 0 ? GAME_SPEED_MS / 2 : budget_ms) *
+		1000000;
+	mcts->max_rollouts = max_rollouts;
+	mcts->root = NULL;
+	mcts->job = 0;
+	mcts->busy = 0;
+	mcts->shutdown = 0;
+	mcts->last_rollouts = 0;
+
+	mcts->workers = aligned_alloc(64, sizeof(mcts_worker_t) * mcts->worker_num);
+	if (mcts->workers == NULL) {
+		fputs("MCTS->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+
+	for (unsigned int i = 0; i < mcts->worker_num; ++i) {
+		mcts_worker_t *worker = &mcts->workers[i];
+		worker->mcts = mcts;
+		worker->node_count = 0;
+		worker->rollouts = 0;
+		game_init(&worker->sim, 0);
+		if ((worker->nodes = malloc(sizeof(mcts_node_t) * MCTS_POOL_SIZE)) == NULL) {
+			fputs("MCTS->FATAL: Could not allocate memory!\n", stderr);
+			exit(1);
+		}
+	}
+	mcts_seed(mcts, seed);
+
+	pthread_mutex_init(&mcts->lock, NULL);
+	pthread_cond_init(&mcts->job_ready, NULL);
+	pthread_cond_init(&mcts->job_done, NULL);
+
+	for (unsigned int i = 1; i < mcts->worker_num; ++i) {
+		if (pthread_create(&mcts->workers[i].thread, NULL, worker_main, &mcts->workers[i]) != 0) {
+			fputs("MCTS->FATAL: Could not create threads!\n", stderr);
+			exit(1);
+		}
+	}
+}
+
+void mcts_seed(mcts_t *restrict mcts, uint64_t seed)
+{
+	/* Stream 0 is the food of a game and 1 the tournament bots */
+	for (unsigned int i = 0; i < mcts->worker_num; ++i)
+		rng_seed(&mcts->workers[i].rng, seed, 2 + i);
+}
+
+void mcts_set_budget(mcts_t *restrict mcts, int64_t budget_ns)
+{
+	mcts->budget_ns = budget_ns;
+}
+
+unsigned char mcts_next(mcts_t *restrict mcts, game_t *restrict game)
+{
+	if (game->over_type != GAME_RUNNING)
+		return 0;
+
+	mcts->root = game;
+	if (mcts->budget_ns != 0) {
+		clock_gettime(CLOCK_MONOTONIC, &mcts->deadline);
+		mcts->deadline.tv_sec += (time_t)(mcts->budget_ns / 1000000000);
+		mcts->deadline.tv_nsec += (long)(mcts->budget_ns % 1000000000);
+		if (mcts->deadline.tv_nsec >= 1000000000L) {
+			++mcts->deadline.tv_sec;
+			mcts->deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	if (mcts->worker_num > 1) {
+		pthread_mutex_lock(&mcts->lock);
+		mcts->busy = mcts->worker_num - 1;
+		++mcts->job;
+		pthread_cond_broadcast(&mcts->job_ready);
+		pthread_mutex_unlock(&mcts->lock);
+	}
+
+	search(&mcts->workers[0]);
+
+	if (mcts->worker_num > 1) {
+		pthread_mutex_lock(&mcts->lock);
+		while (mcts->busy != 0)
+			pthread_cond_wait(&mcts->job_done, &mcts->lock);
+		pthread_mutex_unlock(&mcts->lock);
+	}
+
+	/* The most visited first move over all trees */
+	unsigned long visits[MCTS_MOVES] = { 0 };
+	mcts->last_rollouts = 0;
+	for (unsigned int i = 0; i < mcts->worker_num; ++i) {
+		mcts_worker_t *worker = &mcts->workers[i];
+		mcts->last_rollouts += worker->rollouts;
+		for (unsigned int move = 0; move < MCTS_MOVES; ++move) {
+			uint32_t child = worker->nodes[0].children[move];
+			if (child != 0)
+				visits[move] += worker->nodes[child].visits;
+		}
+	}
+
+	unsigned int best = MOVE_STRAIGHT;
+	for (unsigned int move = 1; move < MCTS_MOVES; ++move) {
+		if (visits[move] > visits[best])
+			best = move;
+	}
+
+	return best == MOVE_STRAIGHT ? 0 : relative_key(game, best);
+}
+
+void mcts_destory(mcts_t *restrict mcts)
+{
+	pthread_mutex_lock(&mcts->lock);
+	mcts->shutdown = 1;
+	pthread_cond_broadcast(&mcts->job_ready);
+	pthread_mutex_unlock(&mcts->lock);
+
+	for (unsigned int i = 0; i < mcts->worker_num; ++i) {
+		if (i > 0)
+			pthread_join(mcts->workers[i].thread, NULL);
+		game_destory(&mcts->workers[i].sim);
+		free(mcts->workers[i].nodes);
+	}
+
+	pthread_mutex_destroy(&mcts->lock);
+	pthread_cond_destroy(&mcts->job_ready);
+	pthread_cond_destroy(&mcts->job_done);
+	free(mcts->workers);
+}
@@ -0,0 +1,139 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Monte Carlo tree search bot, every worker searches its own tree
+ * from the same game and the visits of the first moves are summed up
+ */
+#ifndef __SNAKE_MCTS_H__
+#define __SNAKE_MCTS_H__
+
+#include "common-def.h"
+#include "engine.h"
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+/* Moves relative to the snake: straight, turn left and turn right */
+#define MCTS_MOVES 3
+/* Nodes each worker can add to its tree in one decision */
+#define MCTS_POOL_SIZE (1U << 16)
+/* Steps of a rollout after the tree policy left the tree */
+#define MCTS_ROLLOUT_DEPTH 64
+
+/* Tree node, children are indexes into the pool of the same worker, 0 if not expanded */
+typedef struct {
+	uint32_t children[MCTS_MOVES];
+	uint32_t visits;
+	double value;
+} mcts_node_t;
+
+struct mcts;
+
+/* Worker struct, only touched by its own thread during a search */
+typedef struct {
+	_Alignas(64) struct mcts *mcts;
+	pthread_t thread;
+	/* The game every rollout starts from a fresh copy of */
+	game_t sim;
+	rng_t rng;
+	mcts_node_t *nodes;
+	uint32_t node_count;
+	unsigned long rollouts;
+} mcts_worker_t;
+
+/* MCTS struct, worker 0 is the thread calling mcts_next */
+typedef struct mcts {
+	unsigned int worker_num;
+	/* A decision ends after budget_ns or max_rollouts, 0 disables a limit */
+	int64_t budget_ns;
+	unsigned long max_rollouts;
+	mcts_worker_t *workers;
+	/* The current job */
+	game_t *root;
+	struct timespec deadline;
+	unsigned long job;
+	unsigned int busy;
+	int shutdown;
+	pthread_mutex_t lock;
+	pthread_cond_t job_ready;
+	pthread_cond_t job_done;
+	/* Rollouts of all workers in the last decision */
+	unsigned long last_rollouts;
+} mcts_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Initialize a search and start its thread pool
+ *
+ * Parameters:
+ * mcts: pointer to a search
+ * threads: number of workers, including the calling thread
+ * budget_ms: time limit of a decision, 0 for none
+ * max_rollouts: rollout limit of a decision, 0 for none
+ * seed: seed of the rollouts
+ *
+ * Return:
+ * None
+ *
+ * Note: Without any limit the budget is half of GAME_SPEED_MS,
+ *	   memory is allocated here and by the first search on a new board config
+ */
+extern void mcts_init(mcts_t *restrict mcts, unsigned int threads,
+	long budget_ms, unsigned long max_rollouts, uint64_t seed);
+
+/* Reseed the rollouts of all workers
+ *
+ * Parameters:
+ * mcts: pointer to a search
+ * seed: the new seed
+ *
+ * Return:
+ * None
+ *
+ * Note: With a rollout limit, the same seed and game give the same decision
+ *	   when there is only one worker
+ */
+extern void mcts_seed(mcts_t *restrict mcts, uint64_t seed);
+
+/* Change the time limit of the next decisions
+ *
+ * Parameters:
+ * mcts: pointer to a search
+ * budget_ns: time limit of a decision in nanoseconds, 0 for none
+ *
+ * Return:
+ * None
+ *
+ * Note: Only call it between two decisions
+ */
+extern void mcts_set_budget(mcts_t *restrict mcts, int64_t budget_ns);
+
+/* Search the next move
+ *
+ * Parameters:
+ * mcts: pointer to a search
+ * game: pointer to a running game, it is only read
+ *
+ * Return:
+ * The direction key to pass to game_step, 0 to go straight
+ */
+extern unsigned char mcts_next(mcts_t *restrict mcts, game_t *restrict game);
+
+/* Stop the thread pool and free a search
+ *
+ * Parameters:
+ * mcts: pointer to a search
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it to prevent memory leak
+ */
+extern void mcts_destory(mcts_t *restrict mcts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include "profile.h"
+#include "ticker.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+/* Every power of 2 is split into 32 buckets, so a value is off by 3% at most */
+#define SUB_BITS 5
+#define SUB_COUNT (1U << SUB_BITS)
+/* Larger values, minutes of TSC, go to the last bucket */
+#define MAX_BITS 40
+#define BUCKETS ((MAX_BITS - SUB_BITS) * SUB_COUNT + SUB_COUNT)
+
+/* Histogram struct */
+typedef struct {
+	_Atomic uint64_t count;
+	_Atomic uint64_t max;
+	_Atomic uint64_t buckets[BUCKETS];
+} histogram_t;
+
+static histogram_t histograms[PROFILE_PROBES];
+
+static const char *const probe_names[PROFILE_PROBES] = {
+	"input", "input_to_photon", "tick", "step", "check_over", "gen_food", "render"
+};
+
+/* The first stamp taken, for converting stamps to nanoseconds,
+ * origin_state is 1 while it is being set and 2 once it is set
+ */
+static _Atomic int origin_state;
+static uint64_t origin_stamp;
+static int64_t origin_ns;
+
+#ifndef PROFILE_HAS_TSC
+uint64_t profile_now(void)
+{
+	return (uint64_t)ticker_now();
+}
+#endif
+
+always_inline unsigned int highest_bit(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, word);
+	return (unsigned int)index;
+#else
+	return 63U - (unsigned int)__builtin_clzll(word);
+#endif
+}
+
+always_inline unsigned int bucket_of(uint64_t value)
+{
+	if (value >= (1ULL << MAX_BITS))
+		value = (1ULL << MAX_BITS) - 1;
+	if (value < 2 * SUB_COUNT)
+		return (unsigned int)value;
+
+	unsigned int shift = highest_bit(value) - SUB_BITS;
+	return shift * SUB_COUNT + (unsigned int)(value >> shift);
+}
+
+/* The largest value which falls in a bucket */
+always_inline uint64_t bucket_value(unsigned int bucket)
+{
+	if (bucket < 2 * SUB_COUNT)
+		return bucket;
+
+	unsigned int shift = bucket / SUB_COUNT - 1;
+	uint64_t top = bucket % SUB_COUNT + SUB_COUNT;
+	return ((top + 1) << shift) - 1;
+}
+
+void profile_record(unsigned int probe, uint64_t elapsed)
+{
+	int expected = 0;
+	if (atomic_load_explicit(&origin_state, memory_order_relaxed) == 0 &&
+			atomic_compare_exchange_strong(&origin_state, &expected, 1)) {
+		origin_ns = ticker_now();
+		origin_stamp = profile_now();
+		atomic_store_explicit(&origin_state, 2, memory_order_release);
+	}
+
+	histogram_t *histogram = &histograms[probe];
+	atomic_fetch_add_explicit(&histogram->buckets[bucket_of(elapsed)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+
+	uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+	while (elapsed > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max,
+			elapsed, memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+/* The smallest value with at least per_mille / 1000 of the count at or below it,
+ * the top of its bucket but never more than the max
+ */
+static uint64_t percentile(const histogram_t *restrict histogram, uint64_t count,
+	uint64_t max, unsigned int per_mille)
+{
+	uint64_t rank = (count * per_mille + 999) / 1000, seen = 0;
+
+	for (unsigned int i = 0; i < BUCKETS; ++i) {
+		seen += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+		if (seen >= rank && seen > 0)
+			return bucket_value(i) < max ? bucket_value(i) : max;
+	}
+	return 0;
+}
+
+/* The dump only uses write and integer formatting, printf is not async signal safe */
+static char *put_str(char *out, const char *restrict str, int width)
+{
+	int len = (int)strlen(str);
+	memcpy(out, str, (size_t)len);
+	out += len;
+	for (; len < width; ++len)
+		*out++ = ' ';
+	return out;
+}
+
+static char *put_u64(char *out, uint64_t value, int width)
+{
+	char digits[24];
+	int len = 0;
+	do {
+		digits[len++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	for (int i = len; i < width; ++i)
+		*out++ = ' ';
+	while (len > 0)
+		*out++ = digits[--len];
+	return out;
+}
+
+/* Microseconds with two decimals */
+static char *put_us(char *out, uint64_t stamps, double ns_per_stamp, int width)
+{
+	uint64_t centi_us = (uint64_t)(stamps * ns_per_stamp / 10.0 + 0.5);
+	out = put_u64(out, centi_us / 100, width - 3);
+	*out++ = '.';
+	*out++ = (char)('0' + centi_us / 10 % 10);
+	*out++ = (char)('0' + centi_us % 10);
+	return out;
+}
+
+void profile_dump(int fd)
+{
+	static const char header[] =
+		"probe                count      p50 us      p99 us    p99.9 us      max us\n";
+	char line[128];
+
+	/* The stamps are nanoseconds without a TSC, otherwise they are measured
+	 * against the monotonic clock since the first record
+	 */
+	double ns_per_stamp = 1.0;
+#ifdef PROFILE_HAS_TSC
+	if (atomic_load_explicit(&origin_state, memory_order_acquire) == 2) {
+		uint64_t stamps = profile_now() - origin_stamp;
+		int64_t ns = ticker_now() - origin_ns;
+		ns_per_stamp = stamps > 0 && ns > 0 ? (double)ns / (double)stamps : 0.0;
+	}
+#endif
+
+	write(fd, header, sizeof(header) - 1);
+	for (unsigned int probe = 0; probe < PROFILE_PROBES; ++probe) {
+		const histogram_t *histogram = &histograms[probe];
+		uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+		uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+
+		char *out = put_str(line, probe_names[probe], 16);
+		out = put_u64(out, count, 10);
+		out = put_us(out, percentile(histogram, count, max, 500), ns_per_stamp, 12);
+		out = put_us(out, percentile(histogram, count, max, 990), ns_per_stamp, 12);
+		out = put_us(out, percentile(histogram, count, max, 999), ns_per_stamp, 12);
+		out = put_us(out, max, ns_per_stamp, 12);
+		*out++ = '\n';
+		write(fd, line, (size_t)(out - line));
+	}
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Latency probes, every probe feeds a log linear histogram of the time
+ * between two stamps. Built with -DSNAKE_PROFILE=ON only, otherwise the
+ * macros are empty and nothing is measured
+ */
+#ifndef __SNAKE_PROFILE_H__
+#define __SNAKE_PROFILE_H__
+
+#include "common-def.h"
+
+#include <stdint.h>
+
+/* What is measured
+ * PROFILE_INPUT: a key is read until the tick which turns the snake with it
+ * PROFILE_INPUT_TO_PHOTON: a key is read until the first frame showing the turn is written
+ * PROFILE_TICK: a whole tick, the step and the drawing
+ * PROFILE_STEP: the game step alone
+ * PROFILE_CHECK_OVER: the check for the end of the game
+ * PROFILE_GEN_FOOD: placing a new food
+ * PROFILE_RENDER: encoding and writing a frame
+ */
+enum {
+	PROFILE_INPUT,
+	PROFILE_INPUT_TO_PHOTON,
+	PROFILE_TICK,
+	PROFILE_STEP,
+	PROFILE_CHECK_OVER,
+	PROFILE_GEN_FOOD,
+	PROFILE_RENDER,
+	PROFILE_PROBES
+};
+
+#ifdef SNAKE_PROFILE
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILE_HAS_TSC
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Get a stamp
+ *
+ * Parameters:
+ * None
+ *
+ * Return:
+ * The time stamp counter where there is one, otherwise nanoseconds of the monotonic clock
+ */
+#ifdef PROFILE_HAS_TSC
+always_inline uint64_t profile_now(void)
+{
+	return __rdtsc();
+}
+#else
+extern uint64_t profile_now(void);
+#endif
+
+/* Add the time between two stamps to a probe
+ *
+ * Parameters:
+ * probe: the probe
+ * elapsed: the later stamp minus the earlier one
+ *
+ * Return:
+ * None
+ *
+ * Note: It takes a few atomic adds, any thread may record
+ */
+extern void profile_record(unsigned int probe, uint64_t elapsed);
+
+/* Write the count, p50, p99, p99.9 and max of every probe
+ *
+ * Parameters:
+ * fd: the file descriptor to write to
+ *
+ * Return:
+ * None
+ *
+ * Note: It is async signal safe, so a SIGUSR1 handler may call it
+ */
+extern void profile_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define PROFILE_BEGIN(stamp) uint64_t stamp = profile_now()
+#define PROFILE_END(probe, stamp) profile_record((probe), profile_now() - (stamp))
+/* Only measure when on is true, a constant false leaves nothing behind */
+#define PROFILE_BEGIN_IF(on, stamp) uint64_t stamp = (on) ? profile_now() : 0
+#define PROFILE_END_IF(on, probe, stamp) do { if (on) PROFILE_END(probe, stamp); } while (0)
+#else
+#define PROFILE_BEGIN(stamp)
+#define PROFILE_END(probe, stamp)
+#define PROFILE_BEGIN_IF(on, stamp) (void)(on)
+#define PROFILE_END_IF(on, probe, stamp) (void)(on)
+#endif
+
+#endif
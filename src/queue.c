@@ -2,21 +2,262 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define QUEUE_SIMD_X86 1
+#endif
 
 #include "queue.h"
 
+/* Heap calls of this thread, the engine asserts a step never adds to it */
+static thread_local_var unsigned long long heap_calls = 0;
+
+static void *heap_alloc(void *ctx, size_t size)
+{
+	++heap_calls;
+	return malloc(size);
+}
+
+static void *heap_resize(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	++heap_calls;
+	return realloc(ptr, new_size);
+}
+
+static void heap_release(void *ctx, void *ptr, size_t size)
+{
+	++heap_calls;
+	free(ptr);
+}
+
+const queue_allocator_t queue_default_allocator = {
+	heap_alloc, heap_resize, heap_release, NULL
+};
+
+unsigned long long queue_heap_calls(void)
+{
+	return heap_calls;
+}
+
+/* Blocks are 16 byte aligned and taken from the end of the used part */
+static void *arena_alloc(void *ctx, size_t size)
+{
+	queue_arena_t *arena = ctx;
+	size_t offset = (arena->used + 15) & ~(size_t)15;
+
+	if (offset > arena->size || size > arena->size - offset)
+		return NULL;
+
+	arena->last = offset;
+	arena->used = offset + size;
+	return arena->base + offset;
+}
+
+static void *arena_resize(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	queue_arena_t *arena = ctx;
+
+	/* The last block grows or shrinks in place */
+	if ((unsigned char *)ptr == arena->base + arena->last) {
+		if (new_size > arena->size - arena->last)
+			return NULL;
+		arena->used = arena->last + new_size;
+		return ptr;
+	}
+
+	void *block = arena_alloc(ctx, new_size);
+	if (block != NULL)
+		memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+	return block;
+}
+
+static void arena_release(void *ctx, void *ptr, size_t size)
+{
+	queue_arena_t *arena = ctx;
+
+	/* Only the last block can be given back before a reset */
+	if ((unsigned char *)ptr == arena->base + arena->last &&
+			arena->used == arena->last + size)
+		arena->used = arena->last;
+}
+
+void queue_arena_init(queue_arena_t *restrict arena, void *buffer, size_t size)
+{
+	arena->base = buffer;
+	arena->size = size;
+	arena->used = 0;
+	arena->last = 0;
+	arena->allocator = (queue_allocator_t){ arena_alloc, arena_resize, arena_release, arena };
+}
+
+/* Scalar search of 4 and 8 byte items, the loads compile to plain moves */
+static size_t find_u32_scalar(const unsigned char *data, size_t num, uint32_t key)
+{
+	for (size_t i = 0; i < num; ++i) {
+		uint32_t value;
+		memcpy(&value, data + i * 4, 4);
+		if (value == key)
+			return i;
+	}
+	return num;
+}
+
+static size_t find_u64_scalar(const unsigned char *data, size_t num, uint64_t key)
+{
+	for (size_t i = 0; i < num; ++i) {
+		uint64_t value;
+		memcpy(&value, data + i * 8, 8);
+		if (value == key)
+			return i;
+	}
+	return num;
+}
+
+#ifdef QUEUE_SIMD_X86
+/* Compare 16 items per loop against the broadcast key */
+__attribute__((target("avx2")))
+static size_t find_u32_avx2(const unsigned char *data, size_t num, uint32_t key)
+{
+	const __m256i keys = _mm256_set1_epi32((int)key);
+	size_t i = 0;
+
+	for (; i + 16 <= num; i += 16) {
+		__m256i low = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(data + i * 4)), keys);
+		__m256i high = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(data + i * 4 + 32)), keys);
+		unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(low)) |
+			(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(high)) << 8;
+		if (mask != 0)
+			return i + (size_t)__builtin_ctz(mask);
+	}
+
+	return i + find_u32_scalar(data + i * 4, num - i, key);
+}
+
+__attribute__((target("avx2")))
+static size_t find_u64_avx2(const unsigned char *data, size_t num, uint64_t key)
+{
+	const __m256i keys = _mm256_set1_epi64x((long long)key);
+	size_t i = 0;
+
+	for (; i + 8 <= num; i += 8) {
+		__m256i low = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(data + i * 8)), keys);
+		__m256i high = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(data + i * 8 + 32)), keys);
+		unsigned int mask = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(low)) |
+			(unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(high)) << 4;
+		if (mask != 0)
+			return i + (size_t)__builtin_ctz(mask);
+	}
+
+	return i + find_u64_scalar(data + i * 8, num - i, key);
+}
+
+/* Compare 8 items per loop against the broadcast key */
+__attribute__((target("sse2")))
+static size_t find_u32_sse2(const unsigned char *data, size_t num, uint32_t key)
+{
+	const __m128i keys = _mm_set1_epi32((int)key);
+	size_t i = 0;
+
+	for (; i + 8 <= num; i += 8) {
+		__m128i low = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(data + i * 4)), keys);
+		__m128i high = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(data + i * 4 + 16)), keys);
+		unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(low)) |
+			(unsigned int)_mm_movemask_ps(_mm_castsi128_ps(high)) << 4;
+		if (mask != 0)
+			return i + (size_t)__builtin_ctz(mask);
+	}
+
+	return i + find_u32_scalar(data + i * 4, num - i, key);
+}
+
+/* SSE2 has no 64 bit compare, both 32 bit halves have to match */
+__attribute__((target("sse2")))
+static size_t find_u64_sse2(const unsigned char *data, size_t num, uint64_t key)
+{
+	const __m128i keys = _mm_set1_epi64x((long long)key);
+	size_t i = 0;
+
+	for (; i + 4 <= num; i += 4) {
+		__m128i low = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(data + i * 8)), keys);
+		__m128i high = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(data + i * 8 + 16)), keys);
+		low = _mm_and_si128(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+		high = _mm_and_si128(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+		unsigned int mask = (unsigned int)_mm_movemask_pd(_mm_castsi128_pd(low)) |
+			(unsigned int)_mm_movemask_pd(_mm_castsi128_pd(high)) << 2;
+		if (mask != 0)
+			return i + (size_t)__builtin_ctz(mask);
+	}
+
+	return i + find_u64_scalar(data + i * 8, num - i, key);
+}
+#endif
+
+/* Find an item in a contiguous array, 4 and 8 byte items take the fastest
+ * search the CPU supports and all others fall back to memcmp
+ */
+static void *find_item(const unsigned char *data, size_t num,
+					   const void *item, size_t item_size)
+{
+	size_t index;
+
+	if (item_size == 4) {
+		uint32_t key;
+		memcpy(&key, item, 4);
+#ifdef QUEUE_SIMD_X86
+		if (__builtin_cpu_supports("avx2"))
+			index = find_u32_avx2(data, num, key);
+		else if (__builtin_cpu_supports("sse2"))
+			index = find_u32_sse2(data, num, key);
+		else
+#endif
+			index = find_u32_scalar(data, num, key);
+	} else if (item_size == 8) {
+		uint64_t key;
+		memcpy(&key, item, 8);
+#ifdef QUEUE_SIMD_X86
+		if (__builtin_cpu_supports("avx2"))
+			index = find_u64_avx2(data, num, key);
+		else if (__builtin_cpu_supports("sse2"))
+			index = find_u64_sse2(data, num, key);
+		else
+#endif
+			index = find_u64_scalar(data, num, key);
+	} else {
+		for (index = 0; index < num; ++index) {
+			if (memcmp(data + index * item_size, item, item_size) == 0)
+				break;
+		}
+	}
+
+	return index == num ? NULL : (void *)(data + index * item_size);
+}
+
 void queue_init(queue_t *restrict queue,
 				size_t item_size,
 				size_t init_queue_size,
 				size_t step_size,
 				size_t shrink_size)
 {
-	if ((queue->head = (unsigned char *)malloc(item_size * init_queue_size)) ==
-		NULL) {
+	queue_init_allocator(queue, item_size, init_queue_size, step_size,
+						 shrink_size, &queue_default_allocator);
+}
+
+void queue_init_allocator(queue_t *restrict queue,
+						  size_t item_size,
+						  size_t init_queue_size,
+						  size_t step_size,
+						  size_t shrink_size,
+						  const queue_allocator_t *allocator)
+{
+	if ((queue->head = (unsigned char *)allocator->alloc(
+			 allocator->ctx, item_size * init_queue_size)) == NULL) {
 		fputs("Queue->FATAL: Could not allocate memory!\n", stderr);
 		exit(1);
 	}
 
+	queue->allocator = allocator;
 	queue->tail = queue->head + init_queue_size * item_size;
 	queue->front = queue->head;
 	queue->rear = queue->head;
@@ -38,13 +279,14 @@ void queue_populate_init(queue_t *restrict queue,
 		exit(-1);
 	}
 
-	if ((queue->head = (unsigned char *)malloc(
-			 data_size + step_size * item_size)) == NULL) {
+	if ((queue->head = (unsigned char *)queue_default_allocator.alloc(
+			 NULL, data_size + step_size * item_size)) == NULL) {
 		fputs("Queue->FATAL: Could not allocate memory!\n", stderr);
 		exit(1);
 	}
 
 	memcpy(queue->head, data, data_size);
+	queue->allocator = &queue_default_allocator;
 
 	queue->front = queue->head;
 	queue->rear = queue->head + data_size;
@@ -57,12 +299,10 @@ void queue_populate_init(queue_t *restrict queue,
 
 void *queue_find_the_first_of(queue_t *restrict queue, void *item)
 {
-	for (unsigned char *ptr = queue->front; ptr != queue->rear;
-		 ptr += queue->item_size) {
-		if (memcmp(ptr, item, queue->item_size) == 0)
-			return ptr;
-	}
-	return NULL;
+	return find_item(queue->front,
+					 (size_t)(queue->rear - queue->front) / queue->item_size,
+					 item,
+					 queue->item_size);
 }
 
 void enqueue(queue_t *restrict queue, void *item)
@@ -72,8 +312,10 @@ void enqueue(queue_t *restrict queue, void *item)
 		if (queue->front == queue->head) {
 			unsigned char *prev = queue->head;
 
-			if ((queue->head = (unsigned char *)realloc(
+			if ((queue->head = (unsigned char *)queue->allocator->resize(
+					 queue->allocator->ctx,
 					 queue->head,
+					 queue->tail - queue->head,
 					 queue->tail - queue->head +
 						 queue->step_size * queue->item_size)) == NULL) {
 				fputs("Queue->FATAL: Could not allocate more memory!", stderr);
@@ -89,7 +331,7 @@ void enqueue(queue_t *restrict queue, void *item)
 			/* Always update tail */
 			queue->tail = queue->rear + queue->step_size * queue->item_size;
 		} else {
-			memcpy(queue->head, queue->front, queue->rear - queue->front);
+			memmove(queue->head, queue->front, queue->rear - queue->front);
 			queue->rear = queue->head + (queue->rear - queue->front);
 			queue->front = queue->head;
 		}
@@ -110,17 +352,24 @@ void *dequeue(queue_t *restrict queue)
 			queue->item_size >=
 		queue->shrink_size) {
 		if (queue->front != queue->head) {
-			memcpy(queue->head, queue->front, queue->rear - queue->front);
+			memmove(queue->head, queue->front, queue->rear - queue->front);
 			queue->rear = queue->head + (queue->rear - queue->front);
 			queue->front = queue->head;
 		}
 
 		unsigned char *prev = queue->head;
-		/* if the pointer did not change, don't update front and rear pointer */
-		if ((queue->head = (unsigned char *)realloc(
+		if ((queue->head = (unsigned char *)queue->allocator->resize(
+				 queue->allocator->ctx,
 				 queue->head,
+				 queue->tail - queue->head,
 				 queue->rear - queue->front +
-					 queue->step_size * queue->item_size)) != prev) {
+					 queue->step_size * queue->item_size)) == NULL) {
+			fputs("Queue->FATAL: Could not allocate more memory!", stderr);
+			exit(1);
+		}
+
+		/* if the pointer did not change, don't update front and rear pointer */
+		if (queue->head != prev) {
 			queue->rear += (ptrdiff_t)(queue->head - prev);
 			queue->front = queue->head;
 		}
@@ -132,4 +381,118 @@ void *dequeue(queue_t *restrict queue)
 	queue->front += queue->item_size;
 
 	return (void *)(queue->front - queue->item_size);
-}
\ No newline at end of file
+}
+
+void ring_queue_init(ring_queue_t *restrict queue,
+					 size_t item_size,
+					 size_t init_queue_size)
+{
+	ring_queue_init_allocator(queue, item_size, init_queue_size,
+							  &queue_default_allocator);
+}
+
+void ring_queue_init_allocator(ring_queue_t *restrict queue,
+							   size_t item_size,
+							   size_t init_queue_size,
+							   const queue_allocator_t *allocator)
+{
+	size_t capacity = queue_pow2_capacity(init_queue_size);
+
+	if ((queue->head = (unsigned char *)allocator->alloc(
+			 allocator->ctx, item_size * capacity)) == NULL) {
+		fputs("Queue->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+
+	queue->allocator = allocator;
+	queue->item_size = item_size;
+	queue->mask = capacity - 1;
+	queue->front = 0;
+	queue->len = 0;
+}
+
+void ring_queue_populate_init(ring_queue_t *restrict queue,
+							  size_t item_size,
+							  void *data,
+							  size_t data_size,
+							  size_t init_queue_size)
+{
+	if (data_size % item_size) {
+		fputs("Queue->FATAL: data_size is not aligned properly!\n", stderr);
+		exit(-1);
+	}
+
+	size_t len = data_size / item_size;
+	ring_queue_init(queue, item_size, len > init_queue_size ? len : init_queue_size);
+
+	memcpy(queue->head, data, data_size);
+	queue->len = len;
+}
+
+void ring_queue_copy(ring_queue_t *restrict dst, ring_queue_t *restrict src)
+{
+	size_t buffer_size = (src->mask + 1) * src->item_size;
+
+	if (dst->mask != src->mask || dst->item_size != src->item_size) {
+		if ((dst->head = (unsigned char *)dst->allocator->resize(
+				 dst->allocator->ctx, dst->head,
+				 (dst->mask + 1) * dst->item_size, buffer_size)) == NULL) {
+			fputs("Queue->FATAL: Could not allocate more memory!", stderr);
+			exit(1);
+		}
+	}
+
+	/* Same positions in a buffer of the same capacity */
+	memcpy(dst->head, src->head, buffer_size);
+	dst->item_size = src->item_size;
+	dst->mask = src->mask;
+	dst->front = src->front;
+	dst->len = src->len;
+}
+
+void *ring_queue_find_the_first_of(ring_queue_t *restrict queue, void *item)
+{
+	/* The items wrap at most once, so search two contiguous parts */
+	size_t capacity = queue->mask + 1;
+	size_t first_len =
+		queue->len < capacity - queue->front ? queue->len : capacity - queue->front;
+
+	void *ptr = find_item(queue->head + queue->front * queue->item_size,
+						  first_len,
+						  item,
+						  queue->item_size);
+	if (ptr == NULL)
+		ptr = find_item(queue->head, queue->len - first_len, item, queue->item_size);
+	return ptr;
+}
+
+void ring_enqueue(ring_queue_t *restrict queue, void *item)
+{
+	size_t capacity = queue->mask + 1;
+
+	/* Double the buffer if it is full */
+	if (queue->len == capacity) {
+		if ((queue->head = (unsigned char *)queue->allocator->resize(
+				 queue->allocator->ctx,
+				 queue->head,
+				 capacity * queue->item_size,
+				 2 * capacity * queue->item_size)) == NULL) {
+			fputs("Queue->FATAL: Could not allocate more memory!", stderr);
+			exit(1);
+		}
+
+		/* Move the wrapped part right after the old end of the buffer */
+		memcpy(queue->head + capacity * queue->item_size,
+			   queue->head,
+			   queue->front * queue->item_size);
+
+		queue->mask = 2 * capacity - 1;
+	}
+
+	/* copy the item to the end of the queue */
+	memcpy(queue->head +
+			   ((queue->front + queue->len) & queue->mask) * queue->item_size,
+		   item,
+		   queue->item_size);
+	++queue->len;
+}
@@ -6,12 +6,34 @@
 
 #include "common-def.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 
+/* Allocator callbacks, a queue keeps using the one it was initialized with */
+typedef struct {
+	void *(*alloc)(void *ctx, size_t size);
+	/* Same as realloc, old_size is the current size of the block */
+	void *(*resize)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+	void (*release)(void *ctx, void *ptr, size_t size);
+	void *ctx;
+} queue_allocator_t;
+
+/* Bump allocator over a caller owned buffer for temporary queues,
+ * only the last block can grow or be given back
+ */
+typedef struct {
+	unsigned char *base;
+	size_t size;
+	size_t used;
+	size_t last;
+	queue_allocator_t allocator;
+} queue_arena_t;
+
 /* Queue struct */
 typedef struct {
+	const queue_allocator_t *allocator;
 	size_t item_size;
 	size_t step_size;
 	size_t shrink_size;
@@ -21,10 +43,87 @@ typedef struct {
 	unsigned char *restrict rear;
 } queue_t;
 
+/* Ring buffer queue struct
+ *
+ * The capacity is always a power of two so positions wrap with a mask,
+ * items are never moved unless the buffer has to grow
+ */
+typedef struct {
+	const queue_allocator_t *allocator;
+	size_t item_size;
+	size_t mask;
+	size_t front;
+	size_t len;
+	unsigned char *restrict head;
+} ring_queue_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* malloc, realloc and free */
+extern const queue_allocator_t queue_default_allocator;
+
+/* Get the number of heap calls made through queue_default_allocator
+ *
+ * Parameters:
+ * None
+ *
+ * Return:
+ * Calls made by the current thread so far
+ */
+extern unsigned long long queue_heap_calls(void);
+
+/* Allocate through queue_default_allocator, so the call is counted by
+ * queue_heap_calls() like those of the queues
+ *
+ * Parameters:
+ * size: size of the block
+ *
+ * Return:
+ * The block, or NULL if it could not be allocated
+ *
+ * Note: Give the block back with queue_heap_release
+ */
+always_inline void *queue_heap_alloc(size_t size)
+{
+	return queue_default_allocator.alloc(queue_default_allocator.ctx, size);
+}
+
+always_inline void queue_heap_release(void *ptr, size_t size)
+{
+	queue_default_allocator.release(queue_default_allocator.ctx, ptr, size);
+}
+
+/* Initialize an arena
+ *
+ * Parameters:
+ * arena: pointer to an arena
+ * buffer: memory the blocks are taken from
+ * size: the size of the buffer
+ *
+ * Return:
+ * None
+ *
+ * Note: Pass &arena->allocator to the queue init functions,
+ *	   the queues must be destoryed before the arena is reset
+ */
+extern void queue_arena_init(queue_arena_t *restrict arena, void *buffer, size_t size);
+
+/* Give all blocks of an arena back at once
+ *
+ * Parameters:
+ * arena: pointer to an arena
+ *
+ * Return:
+ * None
+ */
+always_inline void queue_arena_reset(queue_arena_t *restrict arena)
+{
+	arena->used = 0;
+	arena->last = 0;
+}
+
 /* Initialize a queue
  *
  * Parameters:
@@ -40,6 +139,23 @@ extern void queue_init(queue_t *restrict queue,
 					   size_t step_size,
 					   size_t shrink_size);
 
+/* Initialize a queue with an allocator
+ *
+ * Parameters:
+ * queue: pointer to a queue
+ * item_size: the size of each element in the queue
+ * allocator: the allocator of the queue memory, it must outlive the queue
+ *
+ * Return:
+ * None
+ */
+extern void queue_init_allocator(queue_t *restrict queue,
+								 size_t item_size,
+								 size_t init_queue_size,
+								 size_t step_size,
+								 size_t shrink_size,
+								 const queue_allocator_t *allocator);
+
 /* Initialize a queue with some data
  *
  * Parameters:
@@ -171,6 +287,9 @@ always_inline void *queue_back(queue_t *restrict queue)
  * Return:
  * The pointer to the element in the queue,
  * NULL if the item does not exist
+ *
+ * Note: 4 and 8 byte items are compared many at a time with SSE2 or AVX2
+ *	   when the CPU has them
  */
 extern void *queue_find_the_first_of(queue_t *restrict queue, void *item);
 
@@ -212,11 +331,360 @@ extern void *dequeue(queue_t *restrict queue);
  */
 always_inline void queue_destory(queue_t *restrict queue)
 {
-	free(queue->head);
+	queue->allocator->release(queue->allocator->ctx, queue->head,
+							  (size_t)(queue->tail - queue->head));
+}
+
+/* Initialize a ring buffer queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ * item_size: the size of each element in the queue
+ * init_queue_size: the minimum number of elements, rounded up to a power of two
+ *
+ * Return:
+ * None
+ */
+extern void ring_queue_init(ring_queue_t *restrict queue,
+							size_t item_size,
+							size_t init_queue_size);
+
+/* Initialize a ring buffer queue with an allocator
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ * item_size: the size of each element in the queue
+ * init_queue_size: the minimum number of elements, rounded up to a power of two
+ * allocator: the allocator of the queue memory, it must outlive the queue
+ *
+ * Return:
+ * None
+ */
+extern void ring_queue_init_allocator(ring_queue_t *restrict queue,
+									  size_t item_size,
+									  size_t init_queue_size,
+									  const queue_allocator_t *allocator);
+
+/* Initialize a ring buffer queue with some data
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ * item_size: the size of each element in the queue
+ * data: pointer to the data
+ * data_size: the size of the data
+ * init_queue_size: the minimum number of elements, rounded up to a power of two
+ *
+ * Return:
+ * None
+ */
+extern void ring_queue_populate_init(ring_queue_t *restrict queue,
+									 size_t item_size,
+									 void *data,
+									 size_t data_size,
+									 size_t init_queue_size);
+
+/* Get the length of a ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ *
+ * Return:
+ * The number of elements in the queue
+ */
+always_inline size_t ring_queue_len(ring_queue_t *restrict queue)
+{
+	return queue->len;
+}
+
+/* Get an element based on index
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ * index: the index of the element
+ *
+ * Return:
+ * The pointer to the element,
+ * NULL if the item does not exist
+ */
+always_inline void *ring_queue_get_item(ring_queue_t *restrict queue,
+										size_t index)
+{
+	if (index >= queue->len)
+		return NULL;
+
+	return (void *)(queue->head +
+					((queue->front + index) & queue->mask) * queue->item_size);
+}
+
+/* Get an element from the front of the ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ *
+ * Return:
+ * The pointer to the element,
+ * NULL if the item does not exist
+ */
+always_inline void *ring_queue_front(ring_queue_t *restrict queue)
+{
+	if (queue->len == 0)
+		return NULL;
+
+	return (void *)(queue->head + queue->front * queue->item_size);
+}
+
+/* Get an element at the back of the ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ *
+ * Return:
+ * The pointer to the element,
+ * NULL if the item does not exist
+ */
+always_inline void *ring_queue_back(ring_queue_t *restrict queue)
+{
+	if (queue->len == 0)
+		return NULL;
+
+	return (void *)(queue->head +
+					((queue->front + queue->len - 1) & queue->mask) *
+						queue->item_size);
+}
+
+/* Copy a ring queue into another initialized one
+ *
+ * Parameters:
+ * dst: pointer to the ring queue to overwrite
+ * src: pointer to the ring queue to copy
+ *
+ * Return:
+ * None
+ *
+ * Note: Only allocates when the capacities differ,
+ *	   so copying between queues of the same size is a single memcpy
+ */
+extern void ring_queue_copy(ring_queue_t *restrict dst, ring_queue_t *restrict src);
+
+/* Find the first position of an element in a ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ * item: the pointer to the item
+ *
+ * Return:
+ * The pointer to the element in the queue,
+ * NULL if the item does not exist
+ *
+ * Note: 4 and 8 byte items are compared many at a time with SSE2 or AVX2
+ *	   when the CPU has them
+ */
+extern void *ring_queue_find_the_first_of(ring_queue_t *restrict queue,
+										  void *item);
+
+/* Append an element to the end of a ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ * item: pointer to the item
+ *
+ * Return:
+ * None
+ *
+ * Note: The buffer doubles its size when it is full,
+ *	   otherwise no memory is copied or allocated
+ */
+extern void ring_enqueue(ring_queue_t *restrict queue, void *item);
+
+/* Pop an element at the front of a ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ *
+ * Return:
+ * The pointer to the element
+ *
+ * Note: The element stays valid until the next ring_enqueue,
+ *	   Return NULL if there is nothing in the queue
+ */
+always_inline void *ring_dequeue(ring_queue_t *restrict queue)
+{
+	if (queue->len == 0)
+		return NULL;
+
+	void *item = (void *)(queue->head + queue->front * queue->item_size);
+	queue->front = (queue->front + 1) & queue->mask;
+	--queue->len;
+
+	return item;
+}
+
+/* Destory a ring queue
+ *
+ * Parameters:
+ * queue: pointer to a ring queue
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it to prevent memory leak
+ */
+always_inline void ring_queue_destory(ring_queue_t *restrict queue)
+{
+	queue->allocator->release(queue->allocator->ctx, queue->head,
+							  (queue->mask + 1) * queue->item_size);
 }
 
 #ifdef __cplusplus
 }
 #endif
 
+/* Smallest power of two capacity holding size items */
+always_inline size_t queue_pow2_capacity(size_t size)
+{
+	size_t capacity = 1;
+	while (capacity < size)
+		capacity <<= 1;
+	return capacity;
+}
+
+/* Generate a ring queue specialized for one item type
+ *
+ * Parameters:
+ * name: prefix of the generated struct name##_t and its functions
+ * type: the item type
+ *
+ * Generated functions, with the same behaviour as the ring_queue ones:
+ * name##_init(queue, init_size)
+ * name##_init_allocator(queue, init_size, allocator)
+ * name##_populate_init(queue, data, num, init_size)
+ * name##_len(queue)
+ * name##_get_item(queue, index), name##_front(queue), name##_back(queue)
+ * name##_push(queue, item), name##_pop(queue)
+ * name##_find_the_first_of(queue, item)
+ * name##_copy(dst, src)
+ * name##_destory(queue)
+ *
+ * Note: Sizes are known at compile time, so copies and compares are inlined,
+ *	   name##_pop must not be called on an empty queue
+ */
+#define QUEUE_DEFINE(name, type) \
+	typedef struct { \
+		const queue_allocator_t *allocator; \
+		size_t mask; \
+		size_t front; \
+		size_t len; \
+		type *restrict items; \
+	} name##_t; \
+	\
+	always_inline void name##_init_allocator(name##_t *restrict queue, size_t init_size, \
+		const queue_allocator_t *allocator) \
+	{ \
+		size_t capacity = queue_pow2_capacity(init_size); \
+		if ((queue->items = (type *)allocator->alloc(allocator->ctx, \
+				sizeof(type) * capacity)) == NULL) { \
+			fputs("Queue->FATAL: Could not allocate memory!\n", stderr); \
+			exit(1); \
+		} \
+		queue->allocator = allocator; \
+		queue->mask = capacity - 1; \
+		queue->front = 0; \
+		queue->len = 0; \
+	} \
+	\
+	always_inline void name##_init(name##_t *restrict queue, size_t init_size) \
+	{ \
+		name##_init_allocator(queue, init_size, &queue_default_allocator); \
+	} \
+	\
+	always_inline void name##_populate_init(name##_t *restrict queue, \
+		const type *restrict data, size_t num, size_t init_size) \
+	{ \
+		name##_init(queue, num > init_size ? num : init_size); \
+		memcpy(queue->items, data, sizeof(type) * num); \
+		queue->len = num; \
+	} \
+	\
+	always_inline size_t name##_len(const name##_t *restrict queue) \
+	{ \
+		return queue->len; \
+	} \
+	\
+	always_inline type *name##_get_item(const name##_t *restrict queue, size_t index) \
+	{ \
+		return index < queue->len ? \
+			&queue->items[(queue->front + index) & queue->mask] : NULL; \
+	} \
+	\
+	always_inline type *name##_front(const name##_t *restrict queue) \
+	{ \
+		return queue->len != 0 ? &queue->items[queue->front] : NULL; \
+	} \
+	\
+	always_inline type *name##_back(const name##_t *restrict queue) \
+	{ \
+		return queue->len != 0 ? \
+			&queue->items[(queue->front + queue->len - 1) & queue->mask] : NULL; \
+	} \
+	\
+	/* Double the buffer, moving the wrapped part after the old end */ \
+	static void name##_grow(name##_t *restrict queue) \
+	{ \
+		size_t capacity = queue->mask + 1; \
+		if ((queue->items = (type *)queue->allocator->resize(queue->allocator->ctx, \
+				queue->items, capacity * sizeof(type), 2 * capacity * sizeof(type))) == NULL) { \
+			fputs("Queue->FATAL: Could not allocate more memory!", stderr); \
+			exit(1); \
+		} \
+		memcpy(queue->items + capacity, queue->items, queue->front * sizeof(type)); \
+		queue->mask = 2 * capacity - 1; \
+	} \
+	\
+	always_inline void name##_push(name##_t *restrict queue, type item) \
+	{ \
+		if (queue->len == queue->mask + 1) \
+			name##_grow(queue); \
+		queue->items[(queue->front + queue->len++) & queue->mask] = item; \
+	} \
+	\
+	always_inline type name##_pop(name##_t *restrict queue) \
+	{ \
+		type item = queue->items[queue->front]; \
+		queue->front = (queue->front + 1) & queue->mask; \
+		--queue->len; \
+		return item; \
+	} \
+	\
+	always_inline type *name##_find_the_first_of(const name##_t *restrict queue, \
+		const type *restrict item) \
+	{ \
+		for (size_t i = 0; i < queue->len; ++i) { \
+			type *ptr = &queue->items[(queue->front + i) & queue->mask]; \
+			if (memcmp(ptr, item, sizeof(type)) == 0) \
+				return ptr; \
+		} \
+		return NULL; \
+	} \
+	\
+	always_inline void name##_copy(name##_t *restrict dst, const name##_t *restrict src) \
+	{ \
+		if (dst->mask != src->mask) { \
+			if ((dst->items = (type *)dst->allocator->resize(dst->allocator->ctx, dst->items, \
+					(dst->mask + 1) * sizeof(type), (src->mask + 1) * sizeof(type))) == NULL) { \
+				fputs("Queue->FATAL: Could not allocate more memory!", stderr); \
+				exit(1); \
+			} \
+			dst->mask = src->mask; \
+		} \
+		memcpy(dst->items, src->items, (src->mask + 1) * sizeof(type)); \
+		dst->front = src->front; \
+		dst->len = src->len; \
+	} \
+	\
+	always_inline void name##_destory(name##_t *restrict queue) \
+	{ \
+		queue->allocator->release(queue->allocator->ctx, queue->items, \
+			(queue->mask + 1) * sizeof(type)); \
+	}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include "render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+always_inline size_t frame_size(const screen_t *restrict screen)
+{
+	return (size_t)screen->rows * screen->cols * sizeof(screen_cell_t);
+}
+
+/* Block until the game publishes again or the renderer stops */
+always_inline void wait_wake(renderer_t *restrict renderer)
+{
+#ifdef _WIN32
+	WaitForSingleObject(renderer->wake, INFINITE);
+#else
+	/* One read takes every wake up sent since the last one */
+	char bytes[64];
+	while (read(renderer->wake[0], bytes, sizeof(bytes)) == -1 && errno == EINTR)
+		;
+#endif
+}
+
+always_inline void send_wake(renderer_t *restrict renderer)
+{
+#ifdef _WIN32
+	SetEvent(renderer->wake);
+#else
+	/* A full pipe already holds a wake up */
+	char byte = 0;
+	while (write(renderer->wake[1], &byte, 1) == -1 && errno == EINTR)
+		;
+#endif
+}
+
+/* Draw the latest frame whenever there is one, until the renderer stops */
+#ifdef _WIN32
+static DWORD WINAPI render_loop(void *arg)
+#else
+static void *render_loop(void *arg)
+#endif
+{
+	renderer_t *renderer = (renderer_t *)arg;
+	size_t size = frame_size(&renderer->screen);
+#ifdef SNAKE_PROFILE
+	/* A key is carried by several frames, it is only measured on the first */
+	uint64_t shown_stamp = 0;
+#endif
+
+	while (1) {
+		/* Read running first, so a frame published before the stop is drawn */
+		int running = atomic_load_explicit(&renderer->running, memory_order_acquire);
+
+		if (triple_take(&renderer->frames)) {
+			memcpy(renderer->screen.back, triple_read_slot(&renderer->frames), size);
+			PROFILE_BEGIN(flush_start);
+			screen_flush(&renderer->screen);
+			PROFILE_END(PROFILE_RENDER, flush_start);
+#ifdef SNAKE_PROFILE
+			uint64_t stamp = renderer->stamps[renderer->frames.read];
+			if (stamp != 0 && stamp != shown_stamp) {
+				profile_record(PROFILE_INPUT_TO_PHOTON, profile_now() - stamp);
+				shown_stamp = stamp;
+			}
+#endif
+			continue;
+		}
+
+		if (!running)
+			break;
+		wait_wake(renderer);
+	}
+
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+int renderer_start(renderer_t *restrict renderer, short rows, short cols)
+{
+	screen_init(&renderer->screen, rows, cols);
+
+	size_t size = frame_size(&renderer->screen);
+	void *slots[3];
+	for (int i = 0; i < 3; ++i) {
+		if ((slots[i] = malloc(size)) == NULL) {
+			fputs("Render->FATAL: Could not allocate memory!\n", stderr);
+			exit(1);
+		}
+		memcpy(slots[i], renderer->screen.front, size);
+	}
+	triple_init(&renderer->frames, slots[0], slots[1], slots[2]);
+
+	renderer->published = renderer->skipped = 0;
+#ifdef SNAKE_PROFILE
+	renderer->input_stamp = renderer->carried_stamp = 0;
+	memset(renderer->stamps, 0, sizeof(renderer->stamps));
+#endif
+	atomic_store_explicit(&renderer->running, 1, memory_order_relaxed);
+
+#ifdef _WIN32
+	renderer->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	renderer->thread = renderer->wake != NULL ?
+		CreateThread(NULL, 0, render_loop, renderer, 0, NULL) : NULL;
+	return renderer->thread != NULL ? 0 : -1;
+#else
+	if (pipe(renderer->wake) == -1)
+		return -1;
+	fcntl(renderer->wake[1], F_SETFL, fcntl(renderer->wake[1], F_GETFL) | O_NONBLOCK);
+	fcntl(renderer->wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(renderer->wake[1], F_SETFD, FD_CLOEXEC);
+	return pthread_create(&renderer->thread, NULL, render_loop, renderer) == 0 ? 0 : -1;
+#endif
+}
+
+void renderer_publish(renderer_t *restrict renderer, const screen_t *restrict screen)
+{
+	memcpy(triple_write_slot(&renderer->frames), screen->back, frame_size(screen));
+#ifdef SNAKE_PROFILE
+	/* A key stays on the frames until one of them is surely drawn, a newer key
+	 * is not measured while the frame of an older one may still be skipped
+	 */
+	if (triple_taken(&renderer->frames))
+		renderer->carried_stamp = 0;
+	if (renderer->carried_stamp == 0)
+		renderer->carried_stamp = renderer->input_stamp;
+	renderer->input_stamp = 0;
+	renderer->stamps[renderer->frames.write] = renderer->carried_stamp;
+#endif
+	renderer->skipped += (unsigned long long)triple_publish(&renderer->frames);
+	++renderer->published;
+	send_wake(renderer);
+}
+
+void renderer_stop(renderer_t *restrict renderer)
+{
+	atomic_store_explicit(&renderer->running, 0, memory_order_release);
+	send_wake(renderer);
+
+#ifdef _WIN32
+	WaitForSingleObject(renderer->thread, INFINITE);
+	CloseHandle(renderer->thread);
+	CloseHandle(renderer->wake);
+#else
+	pthread_join(renderer->thread, NULL);
+	close(renderer->wake[0]);
+	close(renderer->wake[1]);
+#endif
+
+	for (int i = 0; i < 3; ++i)
+		free(renderer->frames.slots[i]);
+	screen_destory(&renderer->screen);
+}
+
+void renderer_report(const renderer_t *restrict renderer, FILE *restrict file)
+{
+	fprintf(file, "%llu frames published, %llu skipped by a slow terminal\n",
+		renderer->published, renderer->skipped);
+}
@@ -0,0 +1,125 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Render thread, the only writer of the terminal while it runs. The game
+ * publishes whole screens through a triple buffer, so a slow terminal only
+ * makes the thread skip frames and never holds up a tick
+ */
+#ifndef __SNAKE_RENDER_H__
+#define __SNAKE_RENDER_H__
+
+#include "common-def.h"
+#include "tui.h"
+#include "triple.h"
+#include "profile.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* Renderer struct */
+typedef struct {
+	/* What the terminal shows, only touched by the thread */
+	screen_t screen;
+	triple_buffer_t frames;
+	atomic_int running;
+#ifdef _WIN32
+	HANDLE thread;
+	HANDLE wake;
+#else
+	pthread_t thread;
+	/* A byte on the pipe wakes the thread up */
+	int wake[2];
+#endif
+	/* Frames published, and those replaced before the thread took them */
+	unsigned long long published;
+	unsigned long long skipped;
+#ifdef SNAKE_PROFILE
+	/* Stamp of the key turning the snake in the next frame, and the stamp
+	 * every frame carries until the last one published is taken
+	 */
+	uint64_t input_stamp;
+	uint64_t carried_stamp;
+	uint64_t stamps[3];
+#endif
+} renderer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Start the render thread, the terminal is assumed to be cleared
+ *
+ * Parameters:
+ * renderer: pointer to a renderer
+ * rows: number of rows of the screens published
+ * cols: number of columns of the screens published
+ *
+ * Return:
+ * 0 on success, -1 if the thread could not be started
+ */
+extern int renderer_start(renderer_t *restrict renderer, short rows, short cols);
+
+/* Hand the back buffer of a screen to the render thread
+ *
+ * Parameters:
+ * renderer: pointer to a running renderer
+ * screen: pointer to a screen of the size the renderer was started with
+ *
+ * Return:
+ * None
+ *
+ * Note: It copies the cells and returns at once, it never waits for the terminal
+ */
+extern void renderer_publish(renderer_t *restrict renderer, const screen_t *restrict screen);
+
+/* Draw the last frame published and stop the render thread
+ *
+ * Parameters:
+ * renderer: pointer to a running renderer
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it before writing to the terminal directly
+ */
+extern void renderer_stop(renderer_t *restrict renderer);
+
+/* Print how many frames were published and how many were never drawn
+ *
+ * Parameters:
+ * renderer: pointer to a stopped renderer
+ * file: stream to print the report to
+ *
+ * Return:
+ * None
+ */
+extern void renderer_report(const renderer_t *restrict renderer, FILE *restrict file);
+
+#ifdef SNAKE_PROFILE
+/* Measure the time to the first frame drawn after the next publish, from a key
+ *
+ * Parameters:
+ * renderer: pointer to a running renderer
+ * stamp: profile_now() when the key was read
+ *
+ * Return:
+ * None
+ *
+ * Note: A key is not measured while an older one may still be waiting for its frame
+ */
+always_inline void renderer_mark_input(renderer_t *restrict renderer, uint64_t stamp)
+{
+	if (renderer->input_stamp == 0)
+		renderer->input_stamp = stamp;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,265 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "replay.h"
+#include "snake.h"
+
+/* Version 2 headers end before the board fields */
+#define REPLAY_V2_HEADER_SIZE 32
+
+static const unsigned char replay_magic[4] = { 'C', 'S', 'R', 'P' };
+static const unsigned char direction_keys[4] = { UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY };
+
+always_inline void put_u64(unsigned char *restrict buf, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		buf[i] = (unsigned char)(value >> (8 * i));
+}
+
+always_inline void put_u16(unsigned char *restrict buf, uint16_t value)
+{
+	buf[0] = (unsigned char)value;
+	buf[1] = (unsigned char)(value >> 8);
+}
+
+always_inline uint16_t get_u16(const unsigned char *restrict buf)
+{
+	return (uint16_t)(buf[0] | buf[1] << 8);
+}
+
+always_inline uint64_t get_u64(const unsigned char *restrict buf)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i)
+		value |= (uint64_t)buf[i] << (8 * i);
+	return value;
+}
+
+always_inline unsigned char direction_code(unsigned char direction)
+{
+	for (unsigned char i = 0; i < 4; ++i) {
+		if (direction_keys[i] == direction)
+			return i;
+	}
+	return 0;
+}
+
+static void write_header(unsigned char *restrict header,
+						 const game_config_t *restrict config,
+						 uint64_t seed,
+						 uint64_t ticks,
+						 uint64_t event_count)
+{
+	memset(header, 0, REPLAY_HEADER_SIZE);
+	memcpy(header, replay_magic, sizeof(replay_magic));
+	header[4] = REPLAY_VERSION;
+	put_u64(header + 8, seed);
+	put_u64(header + 16, ticks);
+	put_u64(header + 24, event_count);
+	put_u16(header + 32, (uint16_t)config->width);
+	put_u16(header + 34, (uint16_t)config->height);
+	put_u16(header + 36, (uint16_t)config->win_size);
+	put_u16(header + 38, (uint16_t)(config->win_size >> 16));
+}
+
+int replay_writer_open(replay_writer_t *restrict writer,
+					   const char *restrict path,
+					   const game_config_t *restrict config,
+					   uint64_t seed)
+{
+	unsigned char header[REPLAY_HEADER_SIZE];
+
+	if ((writer->file = fopen(path, "wb")) == NULL)
+		return -1;
+
+	/* The tick and event counts are filled in on close */
+	write_header(header, config, seed, 0, 0);
+	if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+		fclose(writer->file);
+		return -1;
+	}
+
+	writer->config = *config;
+	writer->seed = seed;
+	writer->last_tick = 0;
+	writer->event_count = 0;
+
+	return 0;
+}
+
+void replay_writer_event(replay_writer_t *restrict writer,
+						 uint64_t tick,
+						 unsigned char direction)
+{
+	uint64_t value = (tick - writer->last_tick) << 2 | direction_code(direction);
+	unsigned char buf[10];
+	int len = 0;
+
+	/* Turns are rare, so the tick delta is usually one or two bytes */
+	while (value >= 0x80) {
+		buf[len++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	buf[len++] = (unsigned char)value;
+
+	fwrite(buf, 1, len, writer->file);
+	writer->last_tick = tick;
+	++writer->event_count;
+}
+
+int replay_writer_close(replay_writer_t *restrict writer, uint64_t ticks)
+{
+	unsigned char header[REPLAY_HEADER_SIZE];
+	int ret = 0;
+
+	write_header(header, &writer->config, writer->seed, ticks, writer->event_count);
+	if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+			fwrite(header, 1, sizeof(header), writer->file) != sizeof(header))
+		ret = -1;
+
+	if (fclose(writer->file) != 0)
+		ret = -1;
+
+	return ret;
+}
+
+void replay_advance(replay_t *restrict replay)
+{
+	if (replay->events_left == 0 || --replay->events_left == 0)
+		return;
+
+	const unsigned char *end = replay->data + replay->size;
+	uint64_t value = 0;
+	int shift = 0;
+
+	while (1) {
+		/* A truncated file simply has no more events */
+		if (replay->pos == end || shift > 63) {
+			replay->events_left = 0;
+			return;
+		}
+
+		unsigned char byte = *replay->pos++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			break;
+		shift += 7;
+	}
+
+	replay->next_tick += value >> 2;
+	replay->next_direction = direction_keys[value & 3];
+}
+
+void replay_rewind(replay_t *restrict replay)
+{
+	replay->pos = replay->data + replay->events_offset;
+	replay->next_tick = 0;
+
+	/* Decode the first event by advancing from a virtual one */
+	replay->events_left = replay->event_count + 1;
+	replay_advance(replay);
+}
+
+int replay_open(replay_t *restrict replay, const char *restrict path)
+{
+#ifdef _WIN32
+	replay->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (replay->file == INVALID_HANDLE_VALUE)
+		return -1;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(replay->file, &size) || size.QuadPart < REPLAY_V2_HEADER_SIZE) {
+		CloseHandle(replay->file);
+		return -1;
+	}
+	replay->size = (size_t)size.QuadPart;
+
+	replay->mapping = CreateFileMappingA(replay->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (replay->mapping == NULL) {
+		CloseHandle(replay->file);
+		return -1;
+	}
+
+	replay->data = MapViewOfFile(replay->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (replay->data == NULL) {
+		CloseHandle(replay->mapping);
+		CloseHandle(replay->file);
+		return -1;
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < REPLAY_V2_HEADER_SIZE) {
+		close(fd);
+		return -1;
+	}
+	replay->size = (size_t)st.st_size;
+
+	void *data = mmap(NULL, replay->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -1;
+
+	/* Events are only read front to back */
+	madvise(data, replay->size, MADV_SEQUENTIAL);
+	replay->data = data;
+#endif
+
+	if (memcmp(replay->data, replay_magic, sizeof(replay_magic)) != 0 ||
+			(replay->data[4] != REPLAY_VERSION && replay->data[4] != 2)) {
+		replay_close(replay);
+		return -1;
+	}
+
+	if (replay->data[4] == 2) {
+		replay->events_offset = REPLAY_V2_HEADER_SIZE;
+		replay->config = game_default_config;
+	} else {
+		/* The board config follows the v2 header, a truncated one is past the mapping */
+		if (replay->size < REPLAY_HEADER_SIZE) {
+			replay_close(replay);
+			return -1;
+		}
+		replay->events_offset = REPLAY_HEADER_SIZE;
+		replay->config.width = (short)get_u16(replay->data + 32);
+		replay->config.height = (short)get_u16(replay->data + 34);
+		replay->config.win_size = get_u16(replay->data + 36) |
+			(unsigned int)get_u16(replay->data + 38) << 16;
+	}
+
+	if (game_config_error(&replay->config) != NULL) {
+		replay_close(replay);
+		return -1;
+	}
+
+	replay->seed = get_u64(replay->data + 8);
+	replay->ticks = get_u64(replay->data + 16);
+	replay->event_count = get_u64(replay->data + 24);
+	replay_rewind(replay);
+
+	return 0;
+}
+
+void replay_close(replay_t *restrict replay)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(replay->data);
+	CloseHandle(replay->mapping);
+	CloseHandle(replay->file);
+#else
+	munmap((void *)replay->data, replay->size);
+#endif
+}
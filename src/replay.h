@@ -0,0 +1,162 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Compact game replays, a seed plus the ticks the snake turned at
+ *
+ * File layout (little endian):
+ * "CSRP", version, 3 reserved bytes, seed (u64), ticks (u64), event count (u64),
+ * board width (u16), board height (u16), winning length (u32),
+ * then one varint per event: (ticks since the previous event << 2) | direction
+ *
+ * Version 2 files have no board fields and are played on the default board
+ */
+#ifndef __SNAKE_REPLAY_H__
+#define __SNAKE_REPLAY_H__
+
+#include "common-def.h"
+#include "engine.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define REPLAY_VERSION 3
+#define REPLAY_HEADER_SIZE 40
+
+/* Replay writer struct */
+typedef struct {
+	FILE *file;
+	game_config_t config;
+	uint64_t seed;
+	uint64_t last_tick;
+	uint64_t event_count;
+} replay_writer_t;
+
+/* Memory mapped replay struct */
+typedef struct {
+	const unsigned char *data;
+	size_t size;
+	const unsigned char *pos;
+	/* Where the events start, it depends on the version */
+	size_t events_offset;
+	game_config_t config;
+	uint64_t seed;
+	uint64_t ticks;
+	uint64_t event_count;
+	/* The next event, valid while events_left is not 0 */
+	uint64_t next_tick;
+	unsigned char next_direction;
+	uint64_t events_left;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} replay_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Start recording a game
+ *
+ * Parameters:
+ * writer: pointer to a replay writer
+ * path: the file to write
+ * config: pointer to the board config of the game
+ * seed: the seed of the game
+ *
+ * Return:
+ * 0 on success, -1 if the file could not be created
+ */
+extern int replay_writer_open(replay_writer_t *restrict writer,
+							  const char *restrict path,
+							  const game_config_t *restrict config,
+							  uint64_t seed);
+
+/* Record that the snake turned
+ *
+ * Parameters:
+ * writer: pointer to a replay writer
+ * tick: the game tick of the step the turn happened in
+ * direction: the new direction key
+ *
+ * Return:
+ * None
+ */
+extern void replay_writer_event(replay_writer_t *restrict writer,
+								uint64_t tick,
+								unsigned char direction);
+
+/* Finish recording a game
+ *
+ * Parameters:
+ * writer: pointer to a replay writer
+ * ticks: the number of steps of the whole game
+ *
+ * Return:
+ * 0 on success, -1 if the file could not be written
+ */
+extern int replay_writer_close(replay_writer_t *restrict writer, uint64_t ticks);
+
+/* Map a replay file into memory
+ *
+ * Parameters:
+ * replay: pointer to a replay
+ * path: the file to read
+ *
+ * Return:
+ * 0 on success, -1 if the file could not be mapped or is not a valid replay
+ *
+ * Note: The board config of the replay is checked with game_config_error
+ */
+extern int replay_open(replay_t *restrict replay, const char *restrict path);
+
+/* Rewind a replay to its first event
+ *
+ * Parameters:
+ * replay: pointer to a replay
+ *
+ * Return:
+ * None
+ */
+extern void replay_rewind(replay_t *restrict replay);
+
+/* Decode the event after the current one */
+extern void replay_advance(replay_t *restrict replay);
+
+/* Get the input of a tick, ticks must be asked in order
+ *
+ * Parameters:
+ * replay: pointer to a replay
+ * tick: the game tick of the next step
+ *
+ * Return:
+ * The direction key the snake turned to, 0 if it did not turn
+ */
+always_inline unsigned char replay_input(replay_t *restrict replay, uint64_t tick)
+{
+	if (replay->events_left == 0 || replay->next_tick != tick)
+		return 0;
+
+	unsigned char direction = replay->next_direction;
+	replay_advance(replay);
+	return direction;
+}
+
+/* Unmap a replay
+ *
+ * Parameters:
+ * replay: pointer to a replay
+ *
+ * Return:
+ * None
+ */
+extern void replay_close(replay_t *restrict replay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Small seedable PCG32 random number generator
+ */
+#ifndef __SNAKE_RNG_H__
+#define __SNAKE_RNG_H__
+
+#include "common-def.h"
+
+#include <stdint.h>
+
+/* Generator state, every game or worker owns one */
+typedef struct {
+	uint64_t state;
+	uint64_t inc;
+} rng_t;
+
+/* Get the next 32 random bits
+ *
+ * Parameters:
+ * rng: pointer to a generator
+ *
+ * Return:
+ * A uniformly distributed 32 bit number
+ */
+always_inline uint32_t rng_next(rng_t *restrict rng)
+{
+	uint64_t old = rng->state;
+	rng->state = old * 6364136223846793005ULL + rng->inc;
+
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rot = (uint32_t)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/* Seed a generator
+ *
+ * Parameters:
+ * rng: pointer to a generator
+ * seed: the starting state
+ * stream: selects one of 2^63 independent sequences
+ *
+ * Return:
+ * None
+ */
+always_inline void rng_seed(rng_t *restrict rng, uint64_t seed, uint64_t stream)
+{
+	rng->state = 0;
+	rng->inc = (stream << 1) | 1;
+	rng_next(rng);
+	rng->state += seed;
+	rng_next(rng);
+}
+
+/* Get an unbiased random number below a bound
+ *
+ * Parameters:
+ * rng: pointer to a generator
+ * bound: the exclusive upper bound, must not be 0
+ *
+ * Return:
+ * A uniformly distributed number in [0, bound)
+ *
+ * Note: Lemire's multiply and reject method, it only
+ *	   divides when the first draw lands in the biased zone
+ */
+always_inline uint32_t rng_bounded(rng_t *restrict rng, uint32_t bound)
+{
+	uint64_t product = (uint64_t)rng_next(rng) * bound;
+	uint32_t low = (uint32_t)product;
+
+	if (low < bound) {
+		uint32_t threshold = -bound % bound;
+		while (low < threshold) {
+			product = (uint64_t)rng_next(rng) * bound;
+			low = (uint32_t)product;
+		}
+	}
+
+	return (uint32_t)(product >> 32);
+}
+
+#endif
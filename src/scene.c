@@ -0,0 +1,252 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include "scene.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+static const char opt_str[4][14] = {
+	"  New Game  ",
+	" Autopilot  ",
+	"    Help    ",
+	"    Exit    "
+};
+
+/* Where the first option is on the menu */
+static const cord_t opt_pos = { 10, 27 };
+
+void scene_menu(screen_t *restrict screen, int opt)
+{
+	static const char *const menu_lines[] = {
+		"+---------------------------------------------------------------+",
+		"| Author: TIANCHEN TANG                            Version 1.0  |",
+		"|                                                               |",
+		"|                                                               |",
+		"|                         Greedy Snake                          |",
+		"|       #                                                       |",
+		"|       #                                         #             |",
+		"|       ##########@        $                      #             |",
+		"|                                                 #             |",
+		"|                           New Game              #             |",
+		"|        $                 Autopilot       @#######             |",
+		"|                             Help                              |",
+		"|                             Exit                      $       |",
+		"|                Use w and s to move up and down                |",
+		"|                     Press SPACE to select                     |",
+		"+---------------------------------------------------------------+"
+	};
+
+	screen_clear(screen);
+	for (short i = 0; i < (short)(sizeof(menu_lines) / sizeof(menu_lines[0])); ++i)
+		screen_puts(screen, i + 1, 1, menu_lines[i]);
+
+	/* Highlight the selected button */
+	screen_highlight(screen);
+	screen_puts(screen, opt_pos.y + opt, opt_pos.x, opt_str[opt]);
+	screen_cancel_highlight(screen);
+}
+
+int scene_menu_key(screen_t *restrict screen, int *restrict opt, char key)
+{
+	int offset = 0;
+
+	if (key == UP_KEY && *opt != OPT_START)
+		offset = -1;
+	else if (key == DOWN_KEY && *opt != OPT_EXIT)
+		offset = 1;
+	else if (key == CONFIRM_KEY)
+		return 1;
+
+	/* De highlight the previous selection */
+	screen_puts(screen, opt_pos.y + *opt, opt_pos.x, opt_str[*opt]);
+	*opt += offset;
+
+	/* Highlight the current selection */
+	screen_highlight(screen);
+	screen_puts(screen, opt_pos.y + *opt, opt_pos.x, opt_str[*opt]);
+	screen_cancel_highlight(screen);
+	return 0;
+}
+
+void scene_msg_box(screen_t *restrict screen, const view_t *restrict view,
+	short line_num, const char *restrict line, ...)
+{
+	short line_len = (short)strlen(line);
+	short left_x = (view->cols - line_len) / 2 - 2;
+	short top_y = (view->rows - line_num) / 2;
+
+	screen_highlight(screen);
+
+	/* Upper line */
+	screen_put(screen, top_y, left_x, '+');
+	for (short i = 0; i < line_len + 4; ++i)
+		screen_put(screen, top_y, left_x + 1 + i, '-');
+	screen_put(screen, top_y++, left_x + line_len + 5, '+');
+
+	/* Print the body text */
+	va_list ap;
+	va_start(ap, line);
+	for (short i = 0; i < line_num; ++i) {
+		screen_puts(screen, top_y, left_x, "|  ");
+		screen_puts(screen, top_y, left_x + 3, line);
+		screen_puts(screen, top_y++, left_x + 3 + line_len, "  |");
+		line = va_arg(ap, const char *);
+	}
+	va_end(ap);
+
+	/* Bottom line */
+	screen_put(screen, top_y, left_x, '+');
+	for (short i = 0; i < line_len + 4; ++i)
+		screen_put(screen, top_y, left_x + 1 + i, '-');
+	screen_put(screen, top_y++, left_x + line_len + 5, '+');
+
+	screen_cancel_highlight(screen);
+}
+
+void scene_help(screen_t *restrict screen, const view_t *restrict view)
+{
+	scene_msg_box(screen, view, 4,
+		"              Nani            ",
+		"------------------------------",
+		"What? You don't event know how",
+		"to play the snake game???     ");
+}
+
+void scene_goodbye(screen_t *restrict screen, const view_t *restrict view)
+{
+	scene_msg_box(screen, view, 6,
+		"           Goodbye          ",
+		"----------------------------",
+		"Thanks for playing the game!",
+		"Have a nice day (^v^)       ",
+		"                            ",
+		"   Press SPACE to continue  ");
+}
+
+void scene_result(screen_t *restrict screen, const view_t *restrict view,
+	const game_t *restrict game)
+{
+	/* Show the seed so the game can be played again */
+	char seed_line[32];
+	snprintf(seed_line, sizeof(seed_line), "   Seed: %-22" PRIu64, game->seed);
+
+	if (game->over_type == GAME_WON) {
+		scene_msg_box(screen, view, 5,
+			"            You Win            ",
+			"-------------------------------",
+			"Wow, Are you the snake Master?!",
+			seed_line,
+			"    Press SPACE to continue    ");
+	} else {
+		scene_msg_box(screen, view, 5,
+			"            Game Over          ",
+			"-------------------------------",
+			"The snake died miserably (x_x) ",
+			seed_line,
+			"    Press SPACE to continue    ");
+	}
+}
+
+/* Put a board cell on the screen if it is in the viewport */
+always_inline void view_put(screen_t *restrict screen, const view_t *restrict view,
+	short y, short x, char ch)
+{
+	short row = y - view->camera.y, col = x - view->camera.x;
+	if (row >= 1 && row <= view->rows && col >= 1 && col <= view->cols)
+		screen_put(screen, row, col, ch);
+}
+
+/* Keep the head a quarter of the viewport away from its edges on one axis */
+always_inline short follow_axis(short head, short cam, short view, short size)
+{
+	short margin = view / 4;
+	if (head - cam < 1 + margin)
+		cam = head - 1 - margin;
+	else if (head - cam > view - margin)
+		cam = head - view + margin;
+
+	if (cam > size - view)
+		cam = size - view;
+	return cam < 0 ? 0 : cam;
+}
+
+/* Scroll the camera after the head
+ *
+ * Return:
+ * 1 if the viewport has to be redrawn, 0 otherwise
+ */
+always_inline int view_follow(view_t *restrict view, const game_t *restrict game)
+{
+	cord_t head = game_snake_head(game);
+	cord_t old = view->camera;
+
+	view->camera.y = follow_axis(head.y, view->camera.y, view->rows, game->config.height);
+	view->camera.x = follow_axis(head.x, view->camera.x, view->cols, game->config.width);
+	return view->camera.y != old.y || view->camera.x != old.x;
+}
+
+/* Draw every cell of the viewport, the cost follows the terminal and not the board */
+static void draw_view(screen_t *restrict screen, const view_t *restrict view,
+	const game_t *restrict game)
+{
+	const game_config_t *config = &game->config;
+
+	for (short row = 1; row <= view->rows; ++row) {
+		short y = row + view->camera.y;
+		int edge_y = y == 1 || y == config->height;
+
+		for (short col = 1; col <= view->cols; ++col) {
+			short x = col + view->camera.x;
+			int edge_x = x == 1 || x == config->width;
+			char ch = ' ';
+
+			if (edge_y)
+				ch = edge_x ? '+' : '-';
+			else if (edge_x)
+				ch = '|';
+			else if (y < config->height - 1 && x < config->width - 1 &&
+					game_cell_blocked(game, y, x))
+				ch = SNAKE_BODY;
+
+			screen_put(screen, row, col, ch);
+		}
+	}
+
+	cord_t head = game_snake_head(game);
+	view_put(screen, view, head.y, head.x, SNAKE_HEAD);
+	view_put(screen, view, game->food.y, game->food.x, FOOD);
+}
+
+void scene_game(screen_t *restrict screen, view_t *restrict view,
+	const game_t *restrict game)
+{
+	screen_clear(screen);
+
+	cord_t head = game_snake_head(game);
+	view->camera.y = head.y - view->rows / 2;
+	view->camera.x = head.x - view->cols / 2;
+	view_follow(view, game);
+
+	draw_view(screen, view, game);
+}
+
+void scene_step(screen_t *restrict screen, view_t *restrict view,
+	const game_t *restrict game)
+{
+	/* A scrolled viewport is drawn again, otherwise only the changed cells */
+	if (view_follow(view, game)) {
+		draw_view(screen, view, game);
+		return;
+	}
+
+	cord_t neck = game_snake_get(game, game_snake_len(game) - 2);
+	cord_t head = game_snake_head(game);
+
+	view_put(screen, view, neck.y, neck.x, SNAKE_BODY);
+	if (!game->ate_food)
+		view_put(screen, view, game->tail.y, game->tail.x, ' ');
+	view_put(screen, view, head.y, head.x, SNAKE_HEAD);
+	if (game->ate_food)
+		view_put(screen, view, game->food.y, game->food.x, FOOD);
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Menu, message boxes and the board, drawn on a screen by the game and the arcade
+ */
+#ifndef __SNAKE_SCENE_H__
+#define __SNAKE_SCENE_H__
+
+#include "common-def.h"
+#include "tui.h"
+#include "engine.h"
+
+/* The screen fits both the menu and the viewport */
+#define MENU_WIDTH 65
+#define MENU_HEIGHT 16
+
+/* Part of the board shown on the screen, the camera is the board cell
+ * just above and left of its top left corner
+ */
+typedef struct {
+	short rows;
+	short cols;
+	cord_t camera;
+} view_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Draw the menu with an option highlighted
+ *
+ * Parameters:
+ * screen: pointer to a screen of at least MENU_HEIGHT x MENU_WIDTH
+ * opt: the highlighted option
+ *
+ * Return:
+ * None
+ */
+extern void scene_menu(screen_t *restrict screen, int opt);
+
+/* Move the highlighted option of the menu by a key
+ *
+ * Parameters:
+ * screen: pointer to a screen showing the menu
+ * opt: pointer to the highlighted option
+ * key: the key pressed
+ *
+ * Return:
+ * 1 if the option is selected, 0 otherwise
+ */
+extern int scene_menu_key(screen_t *restrict screen, int *restrict opt, char key);
+
+/* Draw a box of text lines in the middle of the viewport
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * view: the viewport
+ * line_num: number of lines
+ * line: the first line, every line has the same length
+ * ...: the other lines
+ *
+ * Return:
+ * None
+ */
+extern void scene_msg_box(screen_t *restrict screen, const view_t *restrict view,
+	short line_num, const char *restrict line, ...);
+
+/* Draw the help, the goodbye or the result of a game over the viewport */
+extern void scene_help(screen_t *restrict screen, const view_t *restrict view);
+extern void scene_goodbye(screen_t *restrict screen, const view_t *restrict view);
+extern void scene_result(screen_t *restrict screen, const view_t *restrict view,
+	const game_t *restrict game);
+
+/* Draw a new game with the head in the middle of the viewport
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * view: pointer to the viewport, its camera is moved
+ * game: pointer to a game
+ *
+ * Return:
+ * None
+ */
+extern void scene_game(screen_t *restrict screen, view_t *restrict view,
+	const game_t *restrict game);
+
+/* Draw the cells changed by the last step, or the whole viewport if it scrolled
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * view: pointer to the viewport, its camera follows the head
+ * game: pointer to a game which has just stepped
+ *
+ * Return:
+ * None
+ */
+extern void scene_step(screen_t *restrict screen, view_t *restrict view,
+	const game_t *restrict game);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
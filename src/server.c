@@ -0,0 +1,478 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Multiplayer server, every client steers one snake of a shared match
+ * over a Unix socket or loopback TCP, all on one epoll loop
+ */
+/* accept4 */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "match.h"
+
+#define DEFAULT_SOCKET "/tmp/csnake.sock"
+#define DEFAULT_PLAYERS 64
+/* Events taken from epoll at once */
+#define MAX_EVENTS 256
+/* A client this many bytes behind is too slow to keep up and dropped */
+#define MAX_BACKLOG (1U << 20)
+
+/* What an epoll event is about, clients are tagged with their player id */
+enum { TAG_CLIENT, TAG_TIMER, TAG_SIGNAL, TAG_LISTEN };
+
+/* Connection of a player */
+typedef struct {
+	/* -1 while the slot is free */
+	int fd;
+	/* Frames from out_pos on are not written yet */
+	match_buffer_t out;
+	size_t out_pos;
+	/* Whether the client got its snapshot and takes the delta frames */
+	int ready;
+	/* Whether epoll waits for the socket to take more */
+	int waits_out;
+} client_t;
+
+static match_t match;
+static client_t *clients;
+static int epoll_fd;
+
+static game_config_t board = { 128, 64, 64 };
+static unsigned int max_players = DEFAULT_PLAYERS;
+static unsigned int foods = 0;
+static long game_speed_ms = GAME_SPEED_MS;
+static uint64_t seed = 0;
+/* Stop after this many ticks, 0 to run until a signal */
+static unsigned long long tick_limit = 0;
+
+/* Tick statistics */
+static unsigned long long step_ns_sum, step_ns_max;
+static unsigned long long send_ns_sum, send_ns_max;
+static unsigned long long frame_bytes, overruns;
+static unsigned int players_max;
+
+always_inline uint64_t event_tag(unsigned int tag, unsigned int id)
+{
+	return (uint64_t)tag << 32 | id;
+}
+
+always_inline unsigned long long elapsed_ns(const struct timespec *restrict from,
+	const struct timespec *restrict to)
+{
+	return (unsigned long long)((to->tv_sec - from->tv_sec) * 1000000000LL +
+		(to->tv_nsec - from->tv_nsec));
+}
+
+/* Board sides out of range become 0, which the config check rejects */
+always_inline short parse_side(const char *restrict arg)
+{
+	long side = strtol(arg, NULL, 0);
+	return side > 0 && side <= SHRT_MAX ? (short)side : 0;
+}
+
+static void watch(int fd, uint32_t events, uint64_t tag)
+{
+	struct epoll_event event = { .events = events, .data.u64 = tag };
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		perror("FATAL->epoll");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void drop_client(unsigned int id)
+{
+	client_t *client = &clients[id];
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	client->fd = -1;
+	client->out.len = client->out_pos = 0;
+	match_leave(&match, id);
+}
+
+/* Write what the socket takes, and wait for it to take the rest */
+static void flush_client(unsigned int id)
+{
+	client_t *client = &clients[id];
+
+	while (client->out_pos < client->out.len) {
+		ssize_t len = send(client->fd, client->out.data + client->out_pos,
+			client->out.len - client->out_pos, MSG_NOSIGNAL);
+		if (len > 0) {
+			client->out_pos += (size_t)len;
+			continue;
+		}
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		drop_client(id);
+		return;
+	}
+
+	if (client->out.len - client->out_pos > MAX_BACKLOG) {
+		drop_client(id);
+		return;
+	}
+
+	int waits_out = client->out_pos < client->out.len;
+	if (client->out_pos == client->out.len)
+		client->out.len = client->out_pos = 0;
+
+	if (waits_out != client->waits_out) {
+		struct epoll_event event = {
+			.events = EPOLLIN | (waits_out ? EPOLLOUT : 0),
+			.data.u64 = event_tag(TAG_CLIENT, id)
+		};
+		epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+		client->waits_out = waits_out;
+	}
+}
+
+/* Keys of a client, a space spawns its snake again after it died */
+static void read_client(unsigned int id)
+{
+	unsigned char keys[256];
+
+	while (1) {
+		ssize_t len = read(clients[id].fd, keys, sizeof(keys));
+		if (len > 0) {
+			for (ssize_t i = 0; i < len; ++i) {
+				if (keys[i] == CONFIRM_KEY)
+					match_respawn(&match, id);
+				else
+					match_input(&match, id, keys[i]);
+			}
+			continue;
+		}
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+
+		drop_client(id);
+		return;
+	}
+}
+
+static void accept_clients(int listen_fd)
+{
+	while (1) {
+		int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd == -1)
+			return;
+
+		/* Frames are small and should leave at once */
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		int id = match_join(&match);
+		if (id < 0) {
+			close(fd);
+			continue;
+		}
+
+		clients[id] = (client_t){ fd, clients[id].out, 0, 0, 0 };
+		watch(fd, EPOLLIN, event_tag(TAG_CLIENT, (unsigned int)id));
+		if (match.alive_num > players_max)
+			players_max = match.alive_num;
+	}
+}
+
+/* Step the match and send the frame, new clients get the whole match instead */
+static void tick(void)
+{
+	struct timespec start, stepped, sent;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	match_step(&match);
+	clock_gettime(CLOCK_MONOTONIC, &stepped);
+
+	/* Nothing is sent before every snapshot is taken, a client dropped
+	 * by a failed send leaves a record for the next frame
+	 */
+	for (unsigned int id = 0; id < max_players; ++id) {
+		client_t *client = &clients[id];
+		if (client->fd == -1)
+			continue;
+
+		if (client->ready) {
+			match_buffer_put(&client->out, match.frame.data, match.frame.len);
+		} else {
+			match_snapshot(&match, id, &client->out);
+			client->ready = 1;
+		}
+	}
+	for (unsigned int id = 0; id < max_players; ++id) {
+		if (clients[id].fd != -1)
+			flush_client(id);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &sent);
+
+	unsigned long long step_ns = elapsed_ns(&start, &stepped);
+	unsigned long long send_ns = elapsed_ns(&stepped, &sent);
+	step_ns_sum += step_ns;
+	send_ns_sum += send_ns;
+	if (step_ns > step_ns_max)
+		step_ns_max = step_ns;
+	if (send_ns > send_ns_max)
+		send_ns_max = send_ns;
+	frame_bytes += match.frame.len;
+}
+
+static int listen_unix(const char *restrict path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fputs("Server->FATAL: The socket path is too long!\n", stderr);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+			listen(fd, SOMAXCONN) == -1) {
+		perror("FATAL->Socket");
+		return -1;
+	}
+	return fd;
+}
+
+/* Only loopback, the server trusts its clients */
+static int listen_tcp(unsigned short port)
+{
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 ||
+			bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+			listen(fd, SOMAXCONN) == -1) {
+		perror("FATAL->Socket");
+		return -1;
+	}
+	return fd;
+}
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-u|--unix path] [-p|--port port] [-n|--players players] [-f|--food food]\n"
+		"          [-W|--width width] [-H|--height height] [--win win_size] [--speed speed_ms]\n"
+		"          [-s|--seed seed] [-t|--ticks ticks]\n"
+		"Clients send %c %c %c %c to turn and '%c' to spawn again, the server sends frames\n"
+		"described in match.h\n", name, UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY, CONFIRM_KEY);
+}
+
+int main(int argc, char *argv[])
+{
+	enum { OPT_WIN = 256, OPT_SPEED };
+	static const struct option long_options[] = {
+		{ "unix", required_argument, NULL, 'u' },
+		{ "port", required_argument, NULL, 'p' },
+		{ "players", required_argument, NULL, 'n' },
+		{ "food", required_argument, NULL, 'f' },
+		{ "width", required_argument, NULL, 'W' },
+		{ "height", required_argument, NULL, 'H' },
+		{ "win", required_argument, NULL, OPT_WIN },
+		{ "speed", required_argument, NULL, OPT_SPEED },
+		{ "seed", required_argument, NULL, 's' },
+		{ "ticks", required_argument, NULL, 't' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *socket_path = DEFAULT_SOCKET;
+	long port = 0;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "u:p:n:f:W:H:s:t:", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'u':
+				socket_path = optarg;
+				break;
+			case 'p':
+				port = strtol(optarg, NULL, 0);
+				break;
+			case 'n':
+				max_players = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case 'f':
+				foods = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case 'W':
+				board.width = parse_side(optarg);
+				break;
+			case 'H':
+				board.height = parse_side(optarg);
+				break;
+			case OPT_WIN:
+				board.win_size = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case OPT_SPEED:
+				game_speed_ms = strtol(optarg, NULL, 0);
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			case 't':
+				tick_limit = strtoull(optarg, NULL, 0);
+				break;
+			default:
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (port < 0 || port > 65535 || game_speed_ms <= 0) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* A food for every four players unless told otherwise */
+	if (foods == 0)
+		foods = max_players / 4 + 1;
+	const char *error = match_config_error(&board, max_players, foods);
+	if (error != NULL) {
+		fprintf(stderr, "Invalid match: %s\n", error);
+		return EXIT_FAILURE;
+	}
+
+	match_init(&match, &board, max_players, foods, seed);
+	if ((clients = calloc(max_players, sizeof(client_t))) == NULL) {
+		fputs("Server->FATAL: Could not allocate memory!\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (unsigned int i = 0; i < max_players; ++i)
+		clients[i].fd = -1;
+
+	if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		perror("FATAL->epoll");
+		return EXIT_FAILURE;
+	}
+
+	int unix_fd = listen_unix(socket_path);
+	int tcp_fd = port != 0 ? listen_tcp((unsigned short)port) : -1;
+	if (unix_fd == -1 || (port != 0 && tcp_fd == -1))
+		return EXIT_FILE_ERR;
+	watch(unix_fd, EPOLLIN, event_tag(TAG_LISTEN, (unsigned int)unix_fd));
+	if (tcp_fd != -1)
+		watch(tcp_fd, EPOLLIN, event_tag(TAG_LISTEN, (unsigned int)tcp_fd));
+
+	/* Signals end the loop instead of the process, so the socket is removed */
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	const struct itimerspec period = {
+		{ game_speed_ms / 1000L, game_speed_ms % 1000L * 1000000L },
+		{ game_speed_ms / 1000L, game_speed_ms % 1000L * 1000000L }
+	};
+	int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (signal_fd == -1 || timer_fd == -1 || timerfd_settime(timer_fd, 0, &period, NULL) == -1) {
+		perror("FATAL->Timer");
+		return EXIT_TIMER_ERR;
+	}
+	watch(signal_fd, EPOLLIN, event_tag(TAG_SIGNAL, 0));
+	watch(timer_fd, EPOLLIN, event_tag(TAG_TIMER, 0));
+
+	printf("Serving %dx%d, %u players, %u food on %s", board.width, board.height,
+		max_players, foods, socket_path);
+	if (port != 0)
+		printf(" and 127.0.0.1:%ld", port);
+	putchar('\n');
+	fflush(stdout);
+
+	struct epoll_event events[MAX_EVENTS];
+	int running = 1;
+	while (running) {
+		int event_num = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (event_num == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("FATAL->epoll");
+			break;
+		}
+
+		for (int i = 0; i < event_num && running; ++i) {
+			unsigned int tag = (unsigned int)(events[i].data.u64 >> 32);
+			unsigned int id = (unsigned int)events[i].data.u64;
+
+			switch (tag) {
+				case TAG_LISTEN:
+					accept_clients((int)id);
+					break;
+				case TAG_SIGNAL:
+					running = 0;
+					break;
+				case TAG_TIMER: {
+					uint64_t expirations;
+					if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+						break;
+
+					/* Late ticks are dropped, the snakes never jump */
+					overruns += expirations - 1;
+					tick();
+					if (tick_limit != 0 && match.tick >= tick_limit)
+						running = 0;
+					break;
+				}
+				default:
+					/* The client may have been dropped by an earlier event */
+					if (clients[id].fd == -1)
+						break;
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+						read_client(id);
+					if (clients[id].fd != -1 && (events[i].events & EPOLLOUT))
+						flush_client(id);
+			}
+		}
+	}
+
+	unsigned long long ticks = match.tick > 0 ? match.tick : 1;
+	printf("%llu ticks, %u players at most, %llu late ticks\n"
+		"step %.1f us mean %.1f us max, send %.1f us mean %.1f us max, %.1f bytes per frame\n"
+		"tick %llu checksum %016llx\n",
+		(unsigned long long)match.tick, players_max, overruns,
+		step_ns_sum / 1e3 / ticks, step_ns_max / 1e3,
+		send_ns_sum / 1e3 / ticks, send_ns_max / 1e3, (double)frame_bytes / ticks,
+		(unsigned long long)match.tick, (unsigned long long)match_checksum(&match));
+
+	for (unsigned int id = 0; id < max_players; ++id) {
+		if (clients[id].fd != -1)
+			drop_client(id);
+		match_buffer_destory(&clients[id].out);
+	}
+	free(clients);
+	match_destory(&match);
+	close(unix_fd);
+	unlink(socket_path);
+	if (tcp_fd != -1)
+		close(tcp_fd);
+	close(timer_fd);
+	close(signal_fd);
+	close(epoll_fd);
+
+	return EXIT_CLEAN;
+}
@@ -3,280 +3,356 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <stdarg.h>
 #include <signal.h>
-#include <assert.h>
+#include <inttypes.h>
 #include <limits.h>
 
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#else
+#include <stdatomic.h>
 #ifndef _WIN32
 #include <pthread.h>
 #endif
+#endif
 
 #include "tui.h"
-#include "queue.h"
-#include "snake.h"
-
-/* Mandatory requirements to have a sensible borad size */
-static_assert(BOARD_WIDTH > 8 && BOARD_WIDTH <= SHRT_MAX,
-	"BOARD_WIDTH is not valid in snake.h!");
-static_assert(BOARD_HEIGHT > 8 && BOARD_HEIGHT <= SHRT_MAX,
-	"BOARD_HEIGHT is not valid in snake.h!");
-static_assert(WIN_SNAKE_SIZE > 3 && WIN_SNAKE_SIZE < (BOARD_HEIGHT - 2) * (BOARD_WIDTH - 2),
-	"WIN_SNAKE_SIZE is not valid in snake.h!");
-
-static queue_t snake;
-static cord_t food;
-static unsigned char snake_direction;
-static unsigned char over_type = 0;
+#include "engine.h"
+#include "scene.h"
+#include "render.h"
+#include "autopilot.h"
+#ifdef SNAKE_HAS_MCTS
+#include <unistd.h>
+#include "mcts.h"
+#endif
+#include "replay.h"
+#include "spsc.h"
+#include "ticker.h"
+#include "profile.h"
 
+#ifdef SNAKE_PROFILE
 #ifdef _WIN32
-static LARGE_INTEGER timer_freq;
-static LARGE_INTEGER key_hit;
-static HANDLE snake_move_mutex;
+#define STDERR_FILENO 2
 #else
-static struct timespec key_hit;
-static pthread_mutex_t snake_move_mutex = PTHREAD_MUTEX_INITIALIZER;
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Where SIGUSR1 appends the histograms, stderr is the terminal the game is drawn on */
+#define PROFILE_DUMP_PATH "snake-profile.txt"
+#endif
+#include <stdatomic.h>
+#endif
+
+static game_t game;
+/* Drawn by the game, then handed to the render thread which owns the terminal */
+static screen_t screen;
+static renderer_t renderer;
+
+/* Board and speed of every game, from the command line or a config file */
+static game_config_t board;
+static long game_speed_ms = GAME_SPEED_MS;
+
+/* Milliseconds per tick of every speed level, from the default speed down */
+static const long level_speed_ms[] = { 200, 150, 100, 75, 50, 35, 25, 15, 10, 5, 2, 1 };
+#define LEVEL_NUM ((long)(sizeof(level_speed_ms) / sizeof(level_speed_ms[0])))
+/* A game goes up a level every accel_foods foods, 0 keeps its speed */
+static unsigned int accel_foods = 0;
+
+/* Clock of the ticks, its jitter is printed on exit when asked for */
+static ticker_t ticker;
+static unsigned char late_policy = TICKER_SKIP;
+static int report_jitter = 0;
+/* Speed of the game being played and the food it ate so far */
+static long tick_ms;
+static unsigned int foods_eaten;
+
+/* Part of the board shown on the screen */
+static view_t view;
+
+/* Seed of every game when it is given on the command line */
+static uint64_t fixed_seed;
+static int seed_is_fixed = 0;
+
+/* Every game is recorded to <prefix><game number>.csr when a prefix is given */
+static const char *record_prefix = NULL;
+static unsigned int record_num = 0;
+static replay_writer_t recorder;
+
+/* The autopilot steers every step while it is on, keys are ignored */
+static autopilot_t pilot;
+static int autopilot_on = 0;
+
+#ifdef SNAKE_HAS_MCTS
+/* The autopilot searches with MCTS on all cores instead when a budget is given */
+static mcts_t mcts;
+static long mcts_budget_ms = 0;
 #endif
 
-static const char initial_snake[4] = { SNAKE_HEAD, SNAKE_BODY, SNAKE_BODY, '\0' };
-static const cord_t initial_snake_cords[3] = {
-	{ BOARD_HEIGHT / 2, BOARD_WIDTH / 2 + 1 },
-	{ BOARD_HEIGHT / 2, BOARD_WIDTH / 2 },
-	{ BOARD_HEIGHT / 2, BOARD_WIDTH / 2 - 1 }
-};
-static const char opt_str[3][14] = {
-	"  New Game  ",
-	"    Help    ",
-	"    Exit    " 
-};
+/* Turns pressed, the game loop applies them at tick boundaries */
+static spsc_ring_t input_ring;
 
-#ifdef _WIN32
-always_inline long time_diff_ms(LARGE_INTEGER *const restrict before,
-	LARGE_INTEGER *const restrict after)
+#ifdef SNAKE_PROFILE
+/* Stamp of the oldest key queued, 0 when it was taken already */
+static _Atomic uint64_t key_stamp;
+#endif
+
+#ifndef __linux__
+/* The input thread is the only producer of the ring. It is left blocked in
+ * getchar after a game, and exits on its next key unless a new game started
+ * first, which then keeps it instead of starting a second producer
+ */
+#define INPUT_GAME_ON 1U
+#define INPUT_THREAD_ALIVE 2U
+static atomic_uint input_state;
+#endif
+
+/* Queue a key pressed */
+always_inline void push_key(char key)
 {
-	return (after->QuadPart - before->QuadPart) * 1000L / timer_freq.QuadPart;
+#ifdef SNAKE_PROFILE
+	uint64_t expected = 0;
+	atomic_compare_exchange_strong(&key_stamp, &expected, profile_now());
+#endif
+	spsc_push(&input_ring, key);
 }
-#else
-always_inline void Sleep(long msec)
+
+always_inline int64_t speed_ns(long speed_ms)
 {
-	struct timespec time_to_sleep = { 0L, msec * 1000000L }, remain;
-	nanosleep(&time_to_sleep, &remain);
+	return (int64_t)speed_ms * 1000000;
 }
 
-always_inline long time_diff_ms(struct timespec *const restrict before,
-	struct timespec *const restrict after)
+/* The speed of the level after a speed, the speed itself once it is the fastest */
+static long next_level(long speed_ms)
 {
-	return (after->tv_sec - before->tv_sec) * 1000L +
-		(after->tv_nsec - before->tv_nsec) / 1000000L;
+	for (long i = 0; i < LEVEL_NUM; ++i) {
+		if (level_speed_ms[i] < speed_ms)
+			return level_speed_ms[i];
+	}
+	return speed_ms;
 }
+
+#ifdef SNAKE_HAS_MCTS
+/* Share of a tick the search of a move may take, the step and the drawing take the rest */
+#define MCTS_TICK_SHARE 2
 #endif
 
-void msg_box(short line_num, const char *restrict line, ...)
+/* Keep the search of a move within the tick, otherwise every tick is late */
+always_inline void fit_mcts_budget(void)
 {
-	short line_len = (short)strlen(line);
-	short left_x = (BOARD_WIDTH - line_len) / 2 - 2;
-	short top_y = (BOARD_HEIGHT - line_num) / 2;
-
-	highlight_text();
-
-	/* Upper line */
-	gotoxy(top_y++, left_x);
-	putchar('+');
-	for (short i = 0; i < line_len + 4; ++i)
-		putchar('-');
-	putchar('+');
-
-	/* Print the body text */
-	va_list ap;
-	va_start(ap, line);
-	for (short i = 0; i < line_num; ++i) {
-		gotoxy(top_y++, left_x);
-		printf("|  %s  |", line);
-		line = va_arg(ap, const char *);
-	}
-	va_end(ap);
-
-	/* Bottom line */
-	gotoxy(top_y++, left_x);
-	putchar('+');
-	for (short i = 0; i < line_len + 4; ++i)
-		putchar('-');
-	putchar('+');
+#ifdef SNAKE_HAS_MCTS
+	if (mcts_budget_ms <= 0)
+		return;
 
-	/* Flush stdout in case of buffering which may
-	 * cause the box not showing on the screen
-	 */
-	fflush(stdout);
-	cancel_highlight();
+	int64_t budget_ns = speed_ns(mcts_budget_ms);
+	int64_t tick_share_ns = ticker.period_ns / MCTS_TICK_SHARE;
+	mcts_set_budget(&mcts, budget_ns < tick_share_ns ? budget_ns : tick_share_ns);
+#endif
+}
 
-	while (getchar() != CONFIRM_KEY)
-		;
+/* Start the ticks of a new game at the configured speed */
+always_inline void start_ticks(void)
+{
+	tick_ms = game_speed_ms;
+	foods_eaten = 0;
+	ticker_start(&ticker, speed_ns(tick_ms));
+	fit_mcts_budget();
 }
 
-always_inline cord_t gen_food(void)
+/* Hand the screen to the render thread, a slow terminal never holds up the game */
+always_inline void present(void)
 {
-	queue_t candidates;
-	queue_init(&candidates, sizeof(cord_t), 512, 64, 512);
-
-	cord_t candidate;
-	for (short i = 2; i < BOARD_HEIGHT - 1; ++i) {
-		candidate.y = i;
-		for (short j = 2; j < BOARD_WIDTH - 1; ++j) {
-			candidate.x = j;
-			if (queue_find_the_first_of(&snake, (void *)&candidate) == NULL)
-				enqueue(&candidates, (void *)&candidate);
-		}
-	}
+	renderer_publish(&renderer, &screen);
+}
 
-	candidate =
-		*(cord_t *)queue_get_item(&candidates, rand() % queue_len(&candidates));
+/* Draw the last frame and give the terminal back */
+static void close_console(void)
+{
+	renderer_stop(&renderer);
+	clrscr();
+	restore_console();
+}
 
-	queue_destory(&candidates);
+/* Show the message box drawn on the screen until SPACE is pressed */
+static void msg_box(void)
+{
+	present();
 
-	return candidate;
+	while (getchar() != CONFIRM_KEY)
+		;
 }
 
-always_inline void check_over(void)
+/* Size the viewport of a board to the terminal */
+static void view_init(const game_config_t *restrict config)
 {
-	cord_t *snake_head = queue_back(&snake);
+	short term_rows, term_cols;
+	terminal_size(&term_rows, &term_cols);
 
-	if (queue_len(&snake) == WIN_SNAKE_SIZE) {
-		over_type = 2;
-		return;
-	} else if (snake_head->x == 1 || snake_head->y == 1 ||
-			snake_head->x == BOARD_WIDTH - 1 ||
-			snake_head->y == BOARD_HEIGHT - 1) {
-		over_type = 1;
+	view.rows = config->height < term_rows ? config->height : term_rows;
+	view.cols = config->width < term_cols ? config->width : term_cols;
+}
+
+/* Move the snake one step and draw the cells it changed */
+always_inline void move_and_draw_snake(unsigned char input)
+{
+	/* The loops stop running late ticks once the game is over, a step after it is ignored anyway */
+	if (game.over_type != GAME_RUNNING)
 		return;
+
+	PROFILE_BEGIN(tick_start);
+	if (autopilot_on) {
+#ifdef SNAKE_HAS_MCTS
+		input = mcts_budget_ms > 0 ? mcts_next(&mcts, &game) : autopilot_next(&pilot, &game);
+#else
+		input = autopilot_next(&pilot, &game);
+#endif
 	}
 
-	for (size_t i = 0; i < queue_len(&snake) - 1; ++i) {
-		if (memcmp(snake_head, queue_get_item(&snake, i), sizeof(cord_t)) == 0) {
-			over_type = 1;
-			return;
-		}
+	if (record_prefix != NULL && game_can_turn(&game, input))
+		replay_writer_event(&recorder, game.tick, input);
+
+	PROFILE_BEGIN(step_start);
+#ifdef SNAKE_PROFILE
+	game_step_profiled(&game, input);
+#else
+	game_step(&game, input);
+#endif
+	PROFILE_END(PROFILE_STEP, step_start);
+
+	/* Going up a level keeps the phase of the ticks */
+	if (game.ate_food && accel_foods != 0 && ++foods_eaten % accel_foods == 0) {
+		tick_ms = next_level(tick_ms);
+		ticker_set_period(&ticker, speed_ns(tick_ms));
+		fit_mcts_budget();
 	}
 
-	over_type = 0;
+	scene_step(&screen, &view, &game);
+	present();
+	PROFILE_END(PROFILE_TICK, tick_start);
 }
 
-always_inline short find_opposite(void)
+/* Take the first queued key which turns the snake */
+always_inline unsigned char next_turn(void)
 {
-	switch (snake_direction) {
-		case UP_KEY:
-			return DOWN_KEY;
-		case DOWN_KEY:
-			return UP_KEY;
-		case LEFT_KEY:
-			return RIGHT_KEY;
-		case RIGHT_KEY:
-			return LEFT_KEY;
-		default:
-			clrscr();
-			restore_console();
-			fputs("Unexpected ERROR!", stderr);
-			exit(EXIT_UNKNOWN);
+	unsigned char key;
+	while (spsc_pop(&input_ring, &key)) {
+		if (game_can_turn(&game, key)) {
+#ifdef SNAKE_PROFILE
+			/* Measured from the oldest key queued, which may be this one or a key before it */
+			uint64_t stamp = atomic_exchange(&key_stamp, 0);
+			if (stamp != 0) {
+				profile_record(PROFILE_INPUT, profile_now() - stamp);
+				renderer_mark_input(&renderer, stamp);
+			}
+#endif
+			return key;
+		}
 	}
+	return 0;
 }
 
-always_inline void draw_board(short height, short width)
+#ifdef __linux__
+/* Single threaded game loop, key presses and ticks wake the same poll */
+always_inline void run_game_loop(void)
 {
-	gotoxy(1, 1);
-
-	putchar('+');
-	for (short i = 0; i < width - 2; ++i)
-		putchar('-');
-	putchar('+');
-	putchar('\n');
-
-	for (short i = 0; i < height - 2; ++i) {
-		putchar('|');
-		gotoxy(i + 2, width);
-		putchar('|');
-		putchar('\n');
+	int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd == -1) {
+		close_console();
+		perror("FATAL->Timer");
+		exit(EXIT_TIMER_ERR);
 	}
 
-	putchar('+');
-	for (short i = 0; i < width - 2; ++i)
-		putchar('-');
-	putchar('+');
+	struct pollfd fds[2] = {
+		{ STDIN_FILENO, POLLIN, 0 },
+		{ timer_fd, POLLIN, 0 }
+	};
 
-	fflush(stdout);
-}
+	spsc_reset(&input_ring);
+#ifdef SNAKE_PROFILE
+	atomic_store(&key_stamp, 0);
+#endif
+	start_ticks();
+
+	while (game.over_type == GAME_RUNNING) {
+		/* The timer goes off at the absolute deadline of the next tick,
+		 * so neither the keys nor the time taken by a tick move it
+		 */
+		const struct itimerspec deadline = {
+			{ 0, 0 },
+			{ ticker.deadline_ns / 1000000000, ticker.deadline_ns % 1000000000 }
+		};
+		if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &deadline, NULL) == -1) {
+			close_console();
+			perror("FATAL->Timer");
+			exit(EXIT_TIMER_ERR);
+		}
 
-/* If the snake ate the food, return true */
-always_inline void move_and_draw_snake(void)
-{
-	cord_t move_offset = { 0, 0 };
-	switch (snake_direction) {
-		case UP_KEY:
-			move_offset.y -= 1;
-			break;
-		case DOWN_KEY:
-			move_offset.y += 1;
-			break;
-		case RIGHT_KEY:
-			move_offset.x += 1;
-			break;
-		case LEFT_KEY:
-			move_offset.x -= 1;
-			break;
-	}
+		if (poll(fds, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			close_console();
+			perror("FATAL->Poll");
+			exit(EXIT_TIMER_ERR);
+		}
 
-	cord_t head_node = *(cord_t *)queue_back(&snake);
-	gotoxy(head_node.y, head_node.x);
-	putchar(SNAKE_BODY);
-
-	head_node.y += move_offset.y;
-	head_node.x += move_offset.x;
-
-	/* Do nothing if the snake ate the food */
-	if (memcmp(&food, &head_node, sizeof(cord_t)) == 0) {
-		food = gen_food();
-		gotoxy(food.y, food.x);
-		putchar(FOOD);
-		fflush(stdout);
-	} else {
-		cord_t *tail_node = dequeue(&snake);
-		gotoxy(tail_node->y, tail_node->x);
-		putchar(' ');
-	}
+		if (fds[0].revents) {
+			/* Stdin stays blocking, its file description is shared with stdout which
+			 * the render thread writes, one read after poll never blocks
+			 */
+			char keys[64];
+			ssize_t len = read(STDIN_FILENO, keys, sizeof(keys));
+
+			/* Stdin is closed or broken, poll would wake at once from now on,
+			 * so the game plays on without keys
+			 */
+			if (len == 0 || (len == -1 && errno != EINTR))
+				fds[0].fd = -1;
+
+			for (ssize_t i = 0; i < len && !autopilot_on; ++i) {
+				if (keys[i] == UP_KEY || keys[i] == DOWN_KEY ||
+						keys[i] == LEFT_KEY || keys[i] == RIGHT_KEY)
+					push_key(keys[i]);
+			}
+		}
 
-	/* Print the new head */
-	enqueue(&snake, &head_node);
-	gotoxy(head_node.y, head_node.x);
-	putchar(SNAKE_HEAD);
+		/* One turn at most per tick keeps quick double turns in order */
+		uint64_t expirations;
+		if ((fds[1].revents & POLLIN) &&
+				read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+			for (unsigned int due = ticker_due(&ticker, ticker_now());
+					due > 0 && game.over_type == GAME_RUNNING; --due)
+				move_and_draw_snake(next_turn());
+		}
+	}
 
-	fflush(stdout);
+	close(timer_fd);
 }
-
+#else
 #ifdef _WIN32
 DWORD WINAPI input_handler(void *dummy)
 #else
 void *input_handler(void *dummy)
 #endif
 {
+	/* Only queue the keys, the snake is moved by the game loop alone */
 	char ch = 0;
-	while (over_type == 0) {
+	while (1) {
 		ch = getchar();
-		if ((ch == UP_KEY || ch == DOWN_KEY || ch == LEFT_KEY || ch == RIGHT_KEY) &&
-				ch != find_opposite() && ch != snake_direction && over_type == 0) {
-			snake_direction = ch;
-#ifdef _WIN32
-			WaitForSingleObject(snake_move_mutex, INFINITE);
-#else
-			pthread_mutex_lock(&snake_move_mutex);
-#endif
-			move_and_draw_snake();
-			check_over();
-#ifdef _WIN32
-			ReleaseMutex(snake_move_mutex);
-			QueryPerformanceCounter(&key_hit);
-#else
-			pthread_mutex_unlock(&snake_move_mutex);
-			clock_gettime(CLOCK_MONOTONIC, &key_hit);
-#endif
-		}
+
+		/* Only exit while no game runs, a game starting at the same time
+		 * makes the exchange fail and keeps the thread
+		 */
+		unsigned int state = atomic_load(&input_state);
+		while (!(state & INPUT_GAME_ON) &&
+				!atomic_compare_exchange_weak(&input_state, &state, state & ~INPUT_THREAD_ALIVE))
+			;
+		if (!(state & INPUT_GAME_ON))
+			break;
+
+		if (ch == UP_KEY || ch == DOWN_KEY || ch == LEFT_KEY || ch == RIGHT_KEY)
+			push_key(ch);
 	}
 
 	ungetc(ch, stdin);
@@ -288,172 +364,137 @@ void *input_handler(void *dummy)
 #endif
 }
 
-always_inline void start_game(void)
+always_inline void run_game_loop(void)
 {
-	/* Game flags initialization */
-	snake_direction = LEFT_KEY;
-
-	srand((unsigned int)time(NULL));
+	/* The thread of the last game may still push, so the ring is drained
+	 * from the consumer side instead of being reset
+	 */
+	unsigned char stale;
+	while (spsc_pop(&input_ring, &stale))
+		;
+#ifdef SNAKE_PROFILE
+	atomic_store(&key_stamp, 0);
+#endif
 
-	/* Initial setup of the game screen */
-	clrscr();
+	unsigned int state = atomic_fetch_or(&input_state, INPUT_GAME_ON | INPUT_THREAD_ALIVE);
+	if (!(state & INPUT_THREAD_ALIVE)) {
+#ifdef _WIN32
+		HANDLE thread_input_handler = CreateThread(NULL, 0, input_handler, NULL, 0, NULL);
+		if (thread_input_handler == NULL) {
+			close_console();
+			perror("FATAL->Thread");
+			exit(EXIT_THREAD_ERR);
+		}
+		CloseHandle(thread_input_handler);
+#else
+		pthread_t thread_input_handler;
+		if (pthread_create(&thread_input_handler, NULL, input_handler, NULL) != 0) {
+			perror("FATAL");
+			exit(EXIT_THREAD_ERR);
+		}
+		pthread_detach(thread_input_handler);
+#endif
+	}
 
-	/* Board */
-	draw_board(BOARD_HEIGHT, BOARD_WIDTH);
+	/* Game loop, one turn at most per tick keeps quick double turns in order */
+	start_ticks();
+	while (game.over_type == GAME_RUNNING) {
+		for (unsigned int due = ticker_wait(&ticker);
+				due > 0 && game.over_type == GAME_RUNNING; --due)
+			move_and_draw_snake(next_turn());
+	}
 
-	/* Initial snake */
-	queue_populate_init(&snake, sizeof(cord_t),
-		(void *)initial_snake_cords, sizeof(initial_snake_cords), 16, 64);
-	
-	gotoxy(BOARD_HEIGHT / 2, BOARD_WIDTH / 2 - 1);
-	puts(initial_snake);
+	atomic_fetch_and(&input_state, ~INPUT_GAME_ON);
+}
+#endif
 
-	/* Food */
-	food = gen_food();
-	gotoxy(food.y, food.x);
-	putchar(FOOD);
+always_inline void draw_game(void)
+{
+	scene_game(&screen, &view, &game);
+	present();
+}
 
-	fflush(stdout);
+always_inline void show_result(void)
+{
+	scene_result(&screen, &view, &game);
+	msg_box();
+}
 
-#ifdef _WIN32
-	HANDLE thread_input_handler =
-		CreateThread(NULL, 0, input_handler, NULL, 0, NULL);
-	if (thread_input_handler == NULL) {
-		clrscr();
-		restore_console();
-		perror("FATAL->Thread");
-		exit(EXIT_THREAD_ERR);
+always_inline void start_game(void)
+{
+	game_init_config(&game, &board, seed_is_fixed ? fixed_seed : (uint64_t)time(NULL));
+
+	if (record_prefix != NULL) {
+		char path[FILENAME_MAX];
+		snprintf(path, sizeof(path), "%s%u.csr", record_prefix, ++record_num);
+		if (replay_writer_open(&recorder, path, &board, game.seed) != 0) {
+			close_console();
+			perror("FATAL->Replay");
+			exit(EXIT_FILE_ERR);
+		}
 	}
 
-	if ((snake_move_mutex = CreateMutexA(NULL, FALSE, NULL)) == NULL) {
-		clrscr();
-		restore_console();
-		perror("FATAL->Mutex");
-		exit(EXIT_THREAD_ERR);
-	}
+	draw_game();
 
-	LARGE_INTEGER now;
-	QueryPerformanceCounter(&key_hit);
-#else
-	pthread_t thread_input_handler;
-	if (pthread_create(&thread_input_handler, NULL, input_handler, NULL) != 0) {
-		perror("FATAL");
-		exit(EXIT_THREAD_ERR);
-	}
+	run_game_loop();
 
-	struct timespec now;
-	clock_gettime(CLOCK_MONOTONIC, &key_hit);
-#endif
+	if (record_prefix != NULL)
+		replay_writer_close(&recorder, game.tick);
 
-	/* Game loop */
-	long diff_ms;
-	while (over_type == 0) {
-#ifdef _WIN32
-		QueryPerformanceCounter(&now);
-#else
-		clock_gettime(CLOCK_MONOTONIC, &now);
-#endif
-		if ((diff_ms = time_diff_ms(&key_hit, &now)) < 200L) {
-			Sleep(GAME_SPEED_MS - diff_ms);
-		} else {
-#ifdef _WIN32
-			WaitForSingleObject(snake_move_mutex, INFINITE);
-#else
-			pthread_mutex_lock(&snake_move_mutex);
-#endif
-			move_and_draw_snake();
-			check_over();
-#ifdef _WIN32
-			ReleaseMutex(snake_move_mutex);
-#else
-			pthread_mutex_unlock(&snake_move_mutex);
-#endif
-			Sleep(GAME_SPEED_MS);
-		}
-	}
+	show_result();
 
-	if (over_type == 2) {
-		msg_box(5,
-				"            You Win            ",
-				"-------------------------------",
-				"Wow, Are you the snake Master?!",
-				"                               ",
-				"    Press SPACE to continue    ");
-	} else {
-		msg_box(5,
-				"            Game Over          ",
-				"-------------------------------",
-				"The snake died miserably (x_x) ",
-				"                               ",
-				"    Press SPACE to continue    ");
+	/* Cleanups */
+	game_destory(&game);
+}
+
+/* Show a recorded game at the normal game speed */
+always_inline void play_replay(replay_t *restrict replay)
+{
+	game_init_config(&game, &replay->config, replay->seed);
+	draw_game();
+
+	start_ticks();
+	while (game.over_type == GAME_RUNNING && game.tick < replay->ticks) {
+		for (unsigned int due = ticker_wait(&ticker); due > 0 &&
+				game.over_type == GAME_RUNNING && game.tick < replay->ticks; --due)
+			move_and_draw_snake(replay_input(replay, game.tick));
 	}
 
-#ifdef _WIN32
-	CloseHandle(thread_input_handler);
-	CloseHandle(snake_move_mutex);
-#endif
+	show_result();
+	game_destory(&game);
+}
 
-	/* Cleanups */
-	over_type = 0;
-	queue_destory(&snake);
+/* Simulate a recorded game without any output but the result */
+always_inline void run_replay_headless(replay_t *restrict replay)
+{
+	static const char *const results[3] = { "running", "lost", "won" };
+	clock_t start = clock();
+
+	game_init_config(&game, &replay->config, replay->seed);
+	while (game.over_type == GAME_RUNNING && game.tick < replay->ticks)
+		game_step(&game, replay_input(replay, game.tick));
+
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("seed=%" PRIu64 " ticks=%" PRIu64 " length=%zu result=%s ticks_per_sec=%.0f\n",
+		game.seed, game.tick, game_snake_len(&game), results[game.over_type],
+		seconds > 0 ? game.tick / seconds : 0.0);
+
+	game_destory(&game);
 }
 
 always_inline int menu(void)
 {
 	int cur_opt = OPT_START;
-	cord_t cur_pos = { 10, 27 };
 
-	clrscr();
-	gotoxy(1, 1);
-
-	puts("+---------------------------------------------------------------+\n"
-		 "| Author: TIANCHEN TANG                            Version 1.0  |\n"
-		 "|                                                               |\n"
-		 "|                                                               |\n"
-		 "|                         Greedy Snake                          |\n"
-		 "|       #                                                       |\n"
-		 "|       #                                         #             |\n"
-		 "|       ##########@        $                      #             |\n"
-		 "|                                                 #             |\n"
-		 "|                           New Game              #             |\n"
-		 "|        $                    Help         @#######             |\n"
-		 "|                             Exit                              |\n"
-		 "|                                                       $       |\n"
-		 "|                Use w and s to move up and down                |\n"
-		 "|                     Press SPACE to select                     |\n"
-		 "+---------------------------------------------------------------+");
-
-	/* Highlight "Start game" button */
-	gotoxy(cur_pos.y, cur_pos.x);
-	highlight_text();
-	puts(opt_str[cur_opt]);
-	cancel_highlight();
+	scene_menu(&screen, cur_opt);
+	present();
 
 	char ch;
 	while (1) {
 		if ((ch = getchar())) {
-			short offset = 0;
-
-			if (ch == UP_KEY && cur_opt != OPT_START)
-				offset = -1;
-			else if (ch == DOWN_KEY && cur_opt != OPT_EXIT)
-				offset = 1;
-			else if (ch == CONFIRM_KEY)
+			if (scene_menu_key(&screen, &cur_opt, ch))
 				return cur_opt;
-
-			/* De highlight the previous selection */
-			gotoxy(cur_pos.y, cur_pos.x);
-			cur_pos.y += offset;
-			cancel_highlight();
-			puts(opt_str[cur_opt]);
-			cur_opt += offset;
-
-			/* Highlight the current selection */
-			gotoxy(cur_pos.y, cur_pos.x);
-			highlight_text();
-			puts(opt_str[cur_opt]);
-			cancel_highlight();
-			fflush(stdout);
+			present();
 		}
 	}
 }
@@ -463,6 +504,11 @@ void signal_handler(int sig_num)
 	clrscr();
 	cancel_highlight();
 
+#ifdef SNAKE_PROFILE
+	if (sig_num != SIGSEGV)
+		profile_dump(STDERR_FILENO);
+#endif
+
 	switch (sig_num) {
 		case SIGINT:
 			puts("SIGINT recieved, exiting...");
@@ -480,17 +526,218 @@ void signal_handler(int sig_num)
 	restore_console();
 }
 
-int main(void)
+#if defined(SNAKE_PROFILE) && !defined(_WIN32)
+/* Dump the latency histograms without stopping the game or touching its screen */
+static void profile_signal_handler(int sig_num)
+{
+	int saved_errno = errno;
+	int fd = open(PROFILE_DUMP_PATH, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		profile_dump(fd);
+		close(fd);
+	}
+	errno = saved_errno;
+}
+#endif
+
+/* Set a board or speed option by its config file key
+ *
+ * Parameters:
+ * key: width, height, win_size, speed_ms, level, accel_foods or late
+ * value: the value as text, late is skip or catch_up
+ *
+ * Return:
+ * 1 if the key is known, 0 otherwise
+ *
+ * Note: Out of range values become 0 (or an unknown late policy),
+ *	   which the config check rejects
+ */
+static int set_option(const char *restrict key, const char *restrict value)
+{
+	long number = strtol(value, NULL, 0);
+	short side = number > 0 && number <= SHRT_MAX ? (short)number : 0;
+
+	if (strcmp(key, "width") == 0)
+		board.width = side;
+	else if (strcmp(key, "height") == 0)
+		board.height = side;
+	else if (strcmp(key, "win_size") == 0)
+		board.win_size = number > 0 && number <= UINT_MAX ? (unsigned int)number : 0;
+	else if (strcmp(key, "speed_ms") == 0)
+		game_speed_ms = number;
+	else if (strcmp(key, "level") == 0)
+		game_speed_ms = number >= 1 && number <= LEVEL_NUM ? level_speed_ms[number - 1] : 0;
+	else if (strcmp(key, "accel_foods") == 0)
+		accel_foods = number > 0 && number <= UINT_MAX ? (unsigned int)number : 0;
+	else if (strcmp(key, "late") == 0)
+		late_policy = strcmp(value, "skip") == 0 ? TICKER_SKIP :
+			strcmp(value, "catch_up") == 0 || strcmp(value, "catch-up") == 0 ?
+			TICKER_CATCH_UP : UCHAR_MAX;
+	else
+		return 0;
+
+	return 1;
+}
+
+/* Read the options of a config file, one "key = value" per line, # starts a comment
+ *
+ * Parameters:
+ * path: the config file
+ *
+ * Return:
+ * 0 on success, -1 if the file could not be read, otherwise the bad line number
+ */
+static int load_config(const char *restrict path)
 {
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return -1;
+
+	char line[256];
+	int line_num = 0, ret = 0;
+	while (ret == 0 && fgets(line, sizeof(line), file) != NULL) {
+		char key[32], value[64];
+		++line_num;
+
+		line[strcspn(line, "#")] = '\0';
+		int fields = sscanf(line, " %31[a-z_] = %63s", key, value);
+		if (fields == EOF || (fields == 0 && line[strspn(line, " \t\r\n")] == '\0'))
+			continue;
+		if (fields != 2 || !set_option(key, value))
+			ret = line_num;
+	}
+
+	fclose(file);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *replay_path = NULL;
+	int headless = 0;
+	board = game_default_config;
+
+	for (int i = 1; i < argc; ++i) {
+		if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) && i + 1 < argc) {
+			int ret = load_config(argv[++i]);
+			if (ret == -1) {
+				fprintf(stderr, "Could not open config %s\n", argv[i]);
+				return EXIT_FILE_ERR;
+			} else if (ret > 0) {
+				fprintf(stderr, "%s:%d: unknown or malformed option\n", argv[i], ret);
+				return EXIT_USAGE;
+			}
+		} else if ((strcmp(argv[i], "-W") == 0 || strcmp(argv[i], "--width") == 0) &&
+				i + 1 < argc) {
+			set_option("width", argv[++i]);
+		} else if ((strcmp(argv[i], "-H") == 0 || strcmp(argv[i], "--height") == 0) &&
+				i + 1 < argc) {
+			set_option("height", argv[++i]);
+		} else if (strcmp(argv[i], "--win") == 0 && i + 1 < argc) {
+			set_option("win_size", argv[++i]);
+		} else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+			set_option("speed_ms", argv[++i]);
+		} else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+			set_option("level", argv[++i]);
+		} else if (strcmp(argv[i], "--accel") == 0 && i + 1 < argc) {
+			set_option("accel_foods", argv[++i]);
+		} else if (strcmp(argv[i], "--late") == 0 && i + 1 < argc) {
+			set_option("late", argv[++i]);
+		} else if (strcmp(argv[i], "--jitter") == 0) {
+			report_jitter = 1;
+		} else if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--seed") == 0) && i + 1 < argc) {
+			fixed_seed = strtoull(argv[++i], NULL, 0);
+			seed_is_fixed = 1;
+		} else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--record") == 0) &&
+				i + 1 < argc) {
+			record_prefix = argv[++i];
+		} else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--play") == 0) &&
+				i + 1 < argc) {
+			replay_path = argv[++i];
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			headless = 1;
+#ifdef SNAKE_HAS_MCTS
+		} else if (strcmp(argv[i], "--mcts") == 0 && i + 1 < argc) {
+			mcts_budget_ms = strtol(argv[++i], NULL, 0);
+#endif
+		} else {
+			fprintf(stderr,
+				"Usage: %s [-c|--config file] [-W|--width width] [-H|--height height]\n"
+				"          [--win win_size] [--speed speed_ms | --level 1-%ld] [--accel foods]\n"
+				"          [--late skip|catch-up] [--jitter]\n"
+				"          [-s|--seed seed] [-r|--record prefix] [-p|--play replay [--headless]]\n"
+#ifdef SNAKE_HAS_MCTS
+				"          [--mcts budget_ms]\n"
+#endif
+				, argv[0], LEVEL_NUM);
+			return EXIT_USAGE;
+		}
+	}
+
+	const char *board_error = game_config_error(&board);
+	if (board_error != NULL || game_speed_ms <= 0 || late_policy == UCHAR_MAX) {
+		fprintf(stderr, "Invalid board: %s\n",
+			board_error != NULL ? board_error :
+			game_speed_ms <= 0 ? "the speed must be positive" :
+			"late ticks are either skip or catch-up");
+		return EXIT_USAGE;
+	}
+	ticker_init(&ticker, late_policy);
+
+	replay_t replay;
+	if (replay_path != NULL && replay_open(&replay, replay_path) != 0) {
+		fprintf(stderr, "Could not open replay %s\n", replay_path);
+		return EXIT_FILE_ERR;
+	}
+
+	if (replay_path != NULL && headless) {
+		run_replay_headless(&replay);
+		replay_close(&replay);
+		return EXIT_CLEAN;
+	}
+
 	/* Signal handler for control + C, segmentation fault, and termination */
 	signal(SIGINT, signal_handler);
 	signal(SIGSEGV, signal_handler);
 	signal(SIGTERM, signal_handler);
+#if defined(SNAKE_PROFILE) && !defined(_WIN32)
+	signal(SIGUSR1, profile_signal_handler);
+#endif
 
 	console_setup();
+	clrscr();
+	view_init(replay_path != NULL ? &replay.config : &board);
+	screen_init(&screen, view.rows > MENU_HEIGHT ? view.rows : MENU_HEIGHT,
+		view.cols > MENU_WIDTH ? view.cols : MENU_WIDTH);
+	if (renderer_start(&renderer, screen.rows, screen.cols) != 0) {
+		restore_console();
+		perror("FATAL->Thread");
+		return EXIT_THREAD_ERR;
+	}
+	autopilot_init(&pilot);
 
-#ifdef _WIN32
-	QueryPerformanceFrequency(&timer_freq);
+	if (replay_path != NULL) {
+		play_replay(&replay);
+		replay_close(&replay);
+
+		close_console();
+		if (report_jitter) {
+			ticker_report(&ticker, stdout);
+			renderer_report(&renderer, stdout);
+		}
+#ifdef SNAKE_PROFILE
+		profile_dump(STDERR_FILENO);
+#endif
+		screen_destory(&screen);
+		autopilot_destory(&pilot);
+		return EXIT_CLEAN;
+	}
+
+#ifdef SNAKE_HAS_MCTS
+	if (mcts_budget_ms > 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		mcts_init(&mcts, cpus > 0 ? (unsigned int)cpus : 1, mcts_budget_ms, 0, (uint64_t)time(NULL));
+	}
 #endif
 
 	int opt_selcted = OPT_START;
@@ -499,27 +746,36 @@ int main(void)
 			case OPT_START:
 				start_game();
 				break;
+			case OPT_AUTOPILOT:
+				autopilot_on = 1;
+				start_game();
+				autopilot_on = 0;
+				break;
 			case OPT_HELP:
-				msg_box(4,
-					"              Nani            ",
-					"------------------------------",
-					"What? You don't event know how",
-					"to play the snake game???     ");
+				scene_help(&screen, &view);
+				msg_box();
 				break;
 		}
 	}
 
 	/* Exit the game */
-	msg_box(6,
-		"           Goodbye          ",
-		"----------------------------",
-		"Thanks for playing the game!",
-		"Have a nice day (^v^)       ",
-		"                            ",
-		"   Press SPACE to continue  ");
+	scene_goodbye(&screen, &view);
+	msg_box();
 
-	clrscr();
-	restore_console();
+	close_console();
+	if (report_jitter) {
+		ticker_report(&ticker, stdout);
+		renderer_report(&renderer, stdout);
+	}
+#ifdef SNAKE_PROFILE
+	profile_dump(STDERR_FILENO);
+#endif
+	screen_destory(&screen);
+	autopilot_destory(&pilot);
+#ifdef SNAKE_HAS_MCTS
+	if (mcts_budget_ms > 0)
+		mcts_destory(&mcts);
+#endif
 
 	return 0;
 }
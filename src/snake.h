@@ -23,7 +23,7 @@
 #define RIGHT_KEY 'd'
 #define CONFIRM_KEY ' '
 
-enum { OPT_START, OPT_HELP, OPT_EXIT };
+enum { OPT_START, OPT_AUTOPILOT, OPT_HELP, OPT_EXIT };
 
 enum {
 	EXIT_CLEAN,
@@ -31,7 +31,10 @@ enum {
 	EXIT_SIG_INT,
 	EXIT_SIG_TERM,
 	EXIT_SIG_SEGV,
-	EXIT_UNKNOWN
+	EXIT_UNKNOWN,
+	EXIT_USAGE,
+	EXIT_FILE_ERR,
+	EXIT_TIMER_ERR
 };
 
 typedef struct {
@@ -0,0 +1,80 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Bounded lock-free single producer single consumer byte ring
+ */
+#ifndef __SNAKE_SPSC_H__
+#define __SNAKE_SPSC_H__
+
+#include "common-def.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Must be a power of two */
+#define SPSC_CAPACITY 64
+
+/* Ring struct, head is only written by the consumer and tail by the producer */
+typedef struct {
+	_Alignas(64) atomic_size_t head;
+	_Alignas(64) atomic_size_t tail;
+	unsigned char items[SPSC_CAPACITY];
+} spsc_ring_t;
+
+/* Empty a ring, only call it while neither side is running
+ *
+ * Parameters:
+ * ring: pointer to a ring
+ *
+ * Return:
+ * None
+ */
+always_inline void spsc_reset(spsc_ring_t *restrict ring)
+{
+	atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+	atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+}
+
+/* Push an item, producer side
+ *
+ * Parameters:
+ * ring: pointer to a ring
+ * item: the item
+ *
+ * Return:
+ * 1 on success, 0 if the ring is full and the item is dropped
+ */
+always_inline int spsc_push(spsc_ring_t *restrict ring, unsigned char item)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	if (tail - head == SPSC_CAPACITY)
+		return 0;
+
+	ring->items[tail & (SPSC_CAPACITY - 1)] = item;
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+	return 1;
+}
+
+/* Pop an item, consumer side
+ *
+ * Parameters:
+ * ring: pointer to a ring
+ * item: where to store the item
+ *
+ * Return:
+ * 1 on success, 0 if the ring is empty
+ */
+always_inline int spsc_pop(spsc_ring_t *restrict ring, unsigned char *restrict item)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head == tail)
+		return 0;
+
+	*item = ring->items[head & (SPSC_CAPACITY - 1)];
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return 1;
+}
+
+#endif
@@ -0,0 +1,263 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Connects many greedy bots to a snake server from one epoll loop,
+ * every bot applies the frames to its own copy of the match
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "match.h"
+
+#define DEFAULT_SOCKET "/tmp/csnake.sock"
+#define MAX_EVENTS 256
+
+/* Bot struct, one connection and its view of the match */
+typedef struct {
+	int fd;
+	match_t view;
+	unsigned int id;
+	/* Bytes received and not applied yet */
+	match_buffer_t in;
+	unsigned long long frames;
+	unsigned long long bytes;
+	unsigned long deaths;
+	unsigned long wins;
+	int bad;
+} bot_t;
+
+static const unsigned char move_keys[4] = { UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY };
+static const short move_dy[4] = { -1, 1, 0, 0 };
+static const short move_dx[4] = { 0, 0, -1, 1 };
+
+static const char *socket_path = DEFAULT_SOCKET;
+static long port = 0;
+
+static int connect_server(void)
+{
+	int fd;
+
+	if (port != 0) {
+		struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((unsigned short)port) };
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		int one = 1;
+		if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 ||
+				connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+			return -1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	} else {
+		struct sockaddr_un addr = { .sun_family = AF_UNIX };
+		strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+		if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 ||
+				connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+			return -1;
+	}
+
+	return fd;
+}
+
+/* Head for the closest food without running into anything */
+static unsigned char greedy(const match_t *restrict view, unsigned int id)
+{
+	const match_player_t *player = &view->players[id];
+	cord_t head = *cord_queue_back(&player->snake);
+	int best_distance = 0;
+	unsigned char best = 0;
+
+	for (unsigned char move = 0; move < 4; ++move) {
+		cord_t next = { head.y + move_dy[move], head.x + move_dx[move] };
+		if (bitboard_test(&view->blocked, next.y, next.x))
+			continue;
+
+		int distance = -1;
+		for (uint32_t i = 0; i <= view->food.mask; ++i) {
+			if (view->food.slots[i] == 0)
+				continue;
+
+			uint32_t cell = view->food.slots[i] - 1;
+			int d = abs(next.y - (int)(cell / (uint32_t)view->config.width)) +
+				abs(next.x - (int)(cell % (uint32_t)view->config.width));
+			if (distance == -1 || d < distance)
+				distance = d;
+		}
+
+		if (best == 0 || distance < best_distance) {
+			best = move_keys[move];
+			best_distance = distance;
+		}
+	}
+
+	return best != player->direction ? best : 0;
+}
+
+/* Apply every whole frame received, then answer the last one */
+static void handle_frames(bot_t *restrict bot)
+{
+	size_t pos = 0;
+	int applied = 0;
+
+	while (bot->in.len - pos >= 4) {
+		const unsigned char *frame = bot->in.data + pos;
+		size_t len = (size_t)frame[0] | (size_t)frame[1] << 8 |
+			(size_t)frame[2] << 16 | (size_t)frame[3] << 24;
+		if (bot->in.len - pos - 4 < len)
+			break;
+
+		unsigned char was = bot->view.players != NULL ? bot->view.players[bot->id].state : 0;
+		if (match_apply(&bot->view, frame + 4, len, &bot->id) != 0)
+			bot->bad = 1;
+		else if (was == MATCH_SLOT_ALIVE && bot->view.players[bot->id].state != MATCH_SLOT_ALIVE) {
+			bot->deaths += bot->view.players[bot->id].result == GAME_LOST;
+			bot->wins += bot->view.players[bot->id].result == GAME_WON;
+		}
+
+		++bot->frames;
+		pos += 4 + len;
+		applied = 1;
+	}
+
+	memmove(bot->in.data, bot->in.data + pos, bot->in.len - pos);
+	bot->in.len -= pos;
+
+	if (!applied || bot->bad)
+		return;
+
+	unsigned char key = bot->view.players[bot->id].state == MATCH_SLOT_ALIVE ?
+		greedy(&bot->view, bot->id) : CONFIRM_KEY;
+	/* A server which is gone shows up as the end of the stream */
+	if (key != 0)
+		send(bot->fd, &key, 1, MSG_NOSIGNAL);
+}
+
+/* Read until the socket is empty, 0 once the server is gone */
+static int read_bot(bot_t *restrict bot)
+{
+	unsigned char buf[65536];
+
+	while (1) {
+		ssize_t len = recv(bot->fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (len > 0) {
+			match_buffer_put(&bot->in, buf, (size_t)len);
+			bot->bytes += (unsigned long long)len;
+			continue;
+		}
+		if (len == -1 && errno == EINTR)
+			continue;
+
+		handle_frames(bot);
+		return len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "unix", required_argument, NULL, 'u' },
+		{ "port", required_argument, NULL, 'p' },
+		{ "bots", required_argument, NULL, 'n' },
+		{ NULL, 0, NULL, 0 }
+	};
+	unsigned int bot_num = 32;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "u:p:n:", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'u':
+				socket_path = optarg;
+				break;
+			case 'p':
+				port = strtol(optarg, NULL, 0);
+				break;
+			case 'n':
+				bot_num = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-u|--unix path] [-p|--port port] [-n|--bots bots]\n",
+					argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	bot_t *bots = calloc(bot_num, sizeof(bot_t));
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (bots == NULL || epoll_fd == -1 || bot_num == 0 || port < 0 || port > 65535) {
+		fputs("Swarm->FATAL: Could not start!\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	unsigned int connected = 0;
+	for (unsigned int i = 0; i < bot_num; ++i) {
+		if ((bots[i].fd = connect_server()) == -1) {
+			perror("FATAL->Connect");
+			return EXIT_FAILURE;
+		}
+
+		struct epoll_event event = { .events = EPOLLIN, .data.u32 = i };
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bots[i].fd, &event);
+		++connected;
+	}
+
+	struct epoll_event events[MAX_EVENTS];
+	while (connected > 0) {
+		int event_num = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (event_num == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (int i = 0; i < event_num; ++i) {
+			bot_t *bot = &bots[events[i].data.u32];
+			if (!read_bot(bot)) {
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, bot->fd, NULL);
+				close(bot->fd);
+				--connected;
+			}
+		}
+	}
+
+	/* Every view which got the last frame must agree with the others */
+	unsigned long long frames = 0, bytes = 0, last_tick = 0;
+	unsigned long deaths = 0, wins = 0, bad = 0, disagree = 0;
+	uint64_t checksum = 0;
+	for (unsigned int i = 0; i < bot_num; ++i) {
+		frames += bots[i].frames;
+		bytes += bots[i].bytes;
+		deaths += bots[i].deaths;
+		wins += bots[i].wins;
+		bad += bots[i].bad;
+		if (bots[i].view.tick > last_tick)
+			last_tick = bots[i].view.tick;
+	}
+	for (unsigned int i = 0; i < bot_num; ++i) {
+		if (bots[i].bad || bots[i].view.tick != last_tick)
+			continue;
+
+		uint64_t sum = match_checksum(&bots[i].view);
+		if (checksum == 0)
+			checksum = sum;
+		disagree += sum != checksum;
+	}
+
+	printf("%u bots, %llu frames, %.1f bytes per frame, %lu deaths, %lu wins\n"
+		"%lu bad frames, %lu views disagree, tick %llu checksum %016llx\n",
+		bot_num, frames, frames != 0 ? (double)bytes / frames : 0.0, deaths, wins,
+		bad, disagree, last_tick, (unsigned long long)checksum);
+
+	for (unsigned int i = 0; i < bot_num; ++i) {
+		match_destory(&bots[i].view);
+		match_buffer_destory(&bots[i].in);
+	}
+	free(bots);
+	close(epoll_fd);
+
+	return bad == 0 && disagree == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,76 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Checks that the autopilot wins every game of a range of seeds, so it never
+ * goes round in a loop or traps itself
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "engine.h"
+#include "autopilot.h"
+
+/* A board and the seeds to play on it */
+typedef struct {
+	game_config_t config;
+	uint64_t seeds;
+} board_case_t;
+
+/* The default board, an odd by odd play area with the cell left out of the cycle,
+ * and an odd number of columns walked by rows, both with a long snake
+ */
+static const board_case_t board_cases[] = {
+	{ { 64, 16, 32 }, 200 },
+	{ { 20, 20, 250 }, 10 },
+	{ { 12, 9, 45 }, 50 }
+};
+
+/* Play one game and report it unless the autopilot wins it
+ *
+ * Parameters:
+ * pilot: pointer to an autopilot
+ * game: pointer to a game to play on
+ * config: pointer to the board config
+ * seed: seed of the game
+ *
+ * Return:
+ * 1 if the autopilot won, 0 otherwise
+ */
+static int play(autopilot_t *restrict pilot, game_t *restrict game,
+	const game_config_t *restrict config, uint64_t seed)
+{
+	/* Far more than a lap of the cycle for every food */
+	const uint64_t max_ticks = (uint64_t)config->width * config->height * config->win_size * 4;
+
+	game_init_config(game, config, seed);
+	while (game->over_type == GAME_RUNNING && game->tick < max_ticks)
+		game_step(game, autopilot_next(pilot, game));
+
+	int won = game->over_type == GAME_WON;
+	if (!won)
+		fprintf(stderr, "%dx%d seed %" PRIu64 ": %s at tick %" PRIu64 " with length %zu\n",
+			config->width, config->height, seed,
+			game->over_type == GAME_LOST ? "lost" : "still running", game->tick,
+			game_snake_len(game));
+
+	game_destory(game);
+	return won;
+}
+
+int main(void)
+{
+	autopilot_t pilot;
+	game_t game;
+	unsigned long games = 0, failures = 0;
+
+	autopilot_init(&pilot);
+	for (size_t i = 0; i < sizeof(board_cases) / sizeof(board_cases[0]); ++i) {
+		for (uint64_t seed = 0; seed < board_cases[i].seeds; ++seed) {
+			failures += !play(&pilot, &game, &board_cases[i].config, seed);
+			++games;
+		}
+	}
+	autopilot_destory(&pilot);
+
+	printf("%lu of %lu games won\n", games - failures, games);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
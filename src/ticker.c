@@ -0,0 +1,113 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
+#include "ticker.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define NS_PER_SEC 1000000000LL
+
+int64_t ticker_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (int64_t)((double)counter.QuadPart * NS_PER_SEC / frequency.QuadPart);
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * NS_PER_SEC + now.tv_nsec;
+#endif
+}
+
+void ticker_init(ticker_t *restrict ticker, unsigned char policy)
+{
+	memset(ticker, 0, sizeof(*ticker));
+	ticker->policy = policy;
+}
+
+void ticker_start(ticker_t *restrict ticker, int64_t period_ns)
+{
+	ticker->period_ns = period_ns;
+	ticker->deadline_ns = ticker_now() + period_ns;
+}
+
+void ticker_set_period(ticker_t *restrict ticker, int64_t period_ns)
+{
+	ticker->deadline_ns += period_ns - ticker->period_ns;
+	ticker->period_ns = period_ns;
+}
+
+unsigned int ticker_due(ticker_t *restrict ticker, int64_t now_ns)
+{
+	if (now_ns < ticker->deadline_ns)
+		return 0;
+
+	int64_t late = now_ns - ticker->deadline_ns;
+	++ticker->wakes;
+	ticker->late_sum_ns += (double)late;
+	ticker->late_square_sum_ns += (double)late * (double)late;
+	if (late > ticker->late_max_ns)
+		ticker->late_max_ns = late;
+
+	/* The ticks whose deadline passed, the one being late included */
+	uint64_t passed = (uint64_t)(late / ticker->period_ns) + 1;
+	uint64_t run = 1;
+	if (ticker->policy == TICKER_CATCH_UP)
+		run = passed < TICKER_MAX_CATCH_UP ? passed : TICKER_MAX_CATCH_UP;
+
+	/* Skipped ticks keep the phase, the next deadline is still a whole
+	 * number of periods after the first one
+	 */
+	ticker->deadline_ns += (int64_t)passed * ticker->period_ns;
+	ticker->ticks += run;
+	ticker->skipped += passed - run;
+	return (unsigned int)run;
+}
+
+unsigned int ticker_wait(ticker_t *restrict ticker)
+{
+	unsigned int due;
+
+	while ((due = ticker_due(ticker, ticker_now())) == 0) {
+#if defined(_WIN32)
+		int64_t left = ticker->deadline_ns - ticker_now();
+		if (left > 0)
+			Sleep((DWORD)((left + 999999) / 1000000));
+#elif defined(__APPLE__)
+		/* No clock_nanosleep, the next deadline is still absolute */
+		int64_t left = ticker->deadline_ns - ticker_now();
+		if (left > 0) {
+			struct timespec time_to_sleep = { left / NS_PER_SEC, left % NS_PER_SEC };
+			nanosleep(&time_to_sleep, NULL);
+		}
+#else
+		struct timespec deadline = {
+			ticker->deadline_ns / NS_PER_SEC, ticker->deadline_ns % NS_PER_SEC
+		};
+		/* EINTR comes back to the loop and sleeps again */
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+#endif
+	}
+
+	return due;
+}
+
+void ticker_report(const ticker_t *restrict ticker, FILE *restrict file)
+{
+	double wakes = ticker->wakes > 0 ? (double)ticker->wakes : 1.0;
+	double mean = ticker->late_sum_ns / wakes;
+	double variance = ticker->late_square_sum_ns / wakes - mean * mean;
+
+	fprintf(file,
+		"%llu ticks, %llu skipped, %.3f ms period, jitter %.1f us mean %.1f us stddev %.1f us max\n",
+		(unsigned long long)ticker->ticks, (unsigned long long)ticker->skipped,
+		ticker->period_ns / 1e6, mean / 1e3, sqrt(variance > 0 ? variance : 0) / 1e3,
+		ticker->late_max_ns / 1e3);
+}
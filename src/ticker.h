@@ -0,0 +1,126 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Fixed timestep clock. Every tick has an absolute deadline on the monotonic
+ * clock, one period after the last one, so sleeping late or handling a key
+ * never moves the ticks after it. Late ticks are either caught up or skipped,
+ * and how late every tick starts is measured
+ */
+#ifndef __SNAKE_TICKER_H__
+#define __SNAKE_TICKER_H__
+
+#include "common-def.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Most ticks run back to back to catch up, the others are skipped */
+#define TICKER_MAX_CATCH_UP 64
+
+/* What happens to the ticks whose deadline passed while the game was busy
+ * TICKER_SKIP: they are dropped, the next tick keeps the phase
+ * TICKER_CATCH_UP: they all run at once
+ */
+enum { TICKER_SKIP, TICKER_CATCH_UP };
+
+/* Ticker struct */
+typedef struct {
+	int64_t period_ns;
+	/* Deadline of the next tick on the monotonic clock */
+	int64_t deadline_ns;
+	unsigned char policy;
+	/* Ticks run and skipped */
+	uint64_t ticks;
+	uint64_t skipped;
+	/* How late the wake ups came after their deadline */
+	uint64_t wakes;
+	int64_t late_max_ns;
+	double late_sum_ns;
+	double late_square_sum_ns;
+} ticker_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Get the time of the monotonic clock
+ *
+ * Parameters:
+ * None
+ *
+ * Return:
+ * The time in nanoseconds
+ */
+extern int64_t ticker_now(void);
+
+/* Initialize a ticker with empty statistics
+ *
+ * Parameters:
+ * ticker: pointer to a ticker
+ * policy: TICKER_SKIP or TICKER_CATCH_UP
+ *
+ * Return:
+ * None
+ */
+extern void ticker_init(ticker_t *restrict ticker, unsigned char policy);
+
+/* Put the first deadline one period from now, the statistics are kept
+ *
+ * Parameters:
+ * ticker: pointer to a ticker
+ * period_ns: nanoseconds between two ticks
+ *
+ * Return:
+ * None
+ */
+extern void ticker_start(ticker_t *restrict ticker, int64_t period_ns);
+
+/* Change the period, the next deadline is one new period after the last tick
+ *
+ * Parameters:
+ * ticker: pointer to a started ticker
+ * period_ns: nanoseconds between two ticks
+ *
+ * Return:
+ * None
+ */
+extern void ticker_set_period(ticker_t *restrict ticker, int64_t period_ns);
+
+/* Take the ticks which are due and move the deadline after them
+ *
+ * Parameters:
+ * ticker: pointer to a started ticker
+ * now_ns: the time from ticker_now()
+ *
+ * Return:
+ * The number of ticks to run now, 0 if the deadline has not come yet
+ */
+extern unsigned int ticker_due(ticker_t *restrict ticker, int64_t now_ns);
+
+/* Sleep until the deadline, then take the ticks which are due
+ *
+ * Parameters:
+ * ticker: pointer to a started ticker
+ *
+ * Return:
+ * The number of ticks to run now, at least 1
+ *
+ * Note: It sleeps with clock_nanosleep(TIMER_ABSTIME) where there is one,
+ *	   so the time taken by the ticks does not add up
+ */
+extern unsigned int ticker_wait(ticker_t *restrict ticker);
+
+/* Print the tick count and the jitter of the wake ups
+ *
+ * Parameters:
+ * ticker: pointer to a ticker
+ * file: where to print
+ *
+ * Return:
+ * None
+ */
+extern void ticker_report(const ticker_t *restrict ticker, FILE *restrict file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,394 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Plays many headless games with bot strategies on all cores
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "autopilot.h"
+#include "mcts.h"
+
+#define MAX_STRATEGIES 8
+
+typedef unsigned char (*strategy_t)(game_t *restrict game, rng_t *restrict rng);
+
+/* Games left for one worker, the owner takes from the begin
+ * and thieves take the upper half from the end
+ */
+typedef struct {
+	_Atomic uint64_t range;
+	char padding[64 - sizeof(uint64_t)];
+} work_range_t;
+
+typedef struct {
+	unsigned long games;
+	unsigned long wins;
+	unsigned long timeouts;
+	unsigned long long length_sum;
+	unsigned long long ticks;
+} result_t;
+
+typedef struct {
+	pthread_t thread;
+	unsigned int id;
+	result_t results[MAX_STRATEGIES];
+} worker_t;
+
+static unsigned int worker_num;
+static work_range_t *ranges;
+static worker_t *workers;
+
+static uint64_t seed_base = 0;
+static unsigned long max_ticks = 100000;
+static game_config_t board;
+/* Limits of every MCTS decision */
+static long mcts_budget_ms = 0;
+static unsigned long mcts_rollouts = 1000;
+static unsigned int strategy_num;
+static strategy_t strategies[MAX_STRATEGIES];
+static const char *strategy_names[MAX_STRATEGIES];
+
+always_inline uint64_t pack_range(uint32_t begin, uint32_t end)
+{
+	return (uint64_t)begin << 32 | end;
+}
+
+/* Board sides out of range become 0, which the config check rejects */
+always_inline short parse_side(const char *restrict arg)
+{
+	long side = strtol(arg, NULL, 0);
+	return side > 0 && side <= SHRT_MAX ? (short)side : 0;
+}
+
+always_inline int is_deadly(game_t *restrict game, short y, short x)
+{
+	if (!game_cell_blocked(game, y, x))
+		return 0;
+
+	/* The tail moves away unless the snake eats */
+	cord_t tail = game_snake_tail(game);
+	return !(tail.y == y && tail.x == x &&
+		!(game->food.y == y && game->food.x == x));
+}
+
+static const unsigned char directions[4] = { UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY };
+static const cord_t offsets[4] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+/* Turn to a random direction once in a while */
+static unsigned char strategy_random(game_t *restrict game, rng_t *restrict rng)
+{
+	return rng_bounded(rng, 4) == 0 ? directions[rng_bounded(rng, 4)] : 0;
+}
+
+/* Take the safe move closest to the food */
+static unsigned char strategy_greedy(game_t *restrict game, rng_t *restrict rng)
+{
+	cord_t head = game_snake_head(game);
+	unsigned char best = 0;
+	int best_dist = 0;
+
+	for (int i = 0; i < 4; ++i) {
+		if (directions[i] != game->direction && !game_can_turn(game, directions[i]))
+			continue;
+
+		short y = head.y + offsets[i].y, x = head.x + offsets[i].x;
+		if (is_deadly(game, y, x))
+			continue;
+
+		int dist = abs(game->food.y - y) + abs(game->food.x - x);
+		if (best == 0 || dist < best_dist) {
+			best = directions[i];
+			best_dist = dist;
+		}
+	}
+
+	return best;
+}
+
+/* Shortest safe path to the food, see autopilot.h */
+static _Thread_local autopilot_t pilot;
+static _Thread_local int pilot_ready = 0;
+
+static unsigned char strategy_autopilot(game_t *restrict game, rng_t *restrict rng)
+{
+	if (!pilot_ready) {
+		autopilot_init(&pilot);
+		pilot_ready = 1;
+	}
+
+	return autopilot_next(&pilot, game);
+}
+
+/* Monte Carlo tree search on one thread, the tournament already uses every core */
+static _Thread_local mcts_t mcts;
+static _Thread_local int mcts_ready = 0;
+
+static unsigned char strategy_mcts(game_t *restrict game, rng_t *restrict rng)
+{
+	if (!mcts_ready) {
+		mcts_init(&mcts, 1, mcts_budget_ms, mcts_rollouts, 0);
+		mcts_ready = 1;
+	}
+
+	/* Same game, same rollouts */
+	if (game->tick == 0)
+		mcts_seed(&mcts, game->seed);
+
+	return mcts_next(&mcts, game);
+}
+
+static const struct {
+	const char *name;
+	strategy_t strategy;
+} known_strategies[] = {
+	{ "random", strategy_random },
+	{ "greedy", strategy_greedy },
+	{ "autopilot", strategy_autopilot },
+	{ "mcts", strategy_mcts }
+};
+
+always_inline void play_game(worker_t *restrict worker, uint32_t index)
+{
+	unsigned int strategy = index % strategy_num;
+	result_t *result = &worker->results[strategy];
+	game_t game;
+	rng_t rng;
+	unsigned long tick = 0;
+
+	/* Bots draw from their own stream so they never shift the food */
+	game_init_config(&game, &board, seed_base + index);
+	rng_seed(&rng, seed_base + index, 1);
+	while (game.over_type == GAME_RUNNING && tick < max_ticks) {
+		game_step(&game, strategies[strategy](&game, &rng));
+		++tick;
+	}
+
+	++result->games;
+	result->wins += game.over_type == GAME_WON;
+	result->timeouts += game.over_type == GAME_RUNNING;
+	result->length_sum += game_snake_len(&game);
+	result->ticks += tick;
+
+	game_destory(&game);
+}
+
+/* Take the next game of a worker's own range */
+always_inline int take_own(work_range_t *restrict range, uint32_t *index)
+{
+	uint64_t old = atomic_load(&range->range);
+	uint32_t begin, end;
+
+	do {
+		begin = (uint32_t)(old >> 32);
+		end = (uint32_t)old;
+		if (begin >= end)
+			return 0;
+	} while (!atomic_compare_exchange_weak(&range->range, &old, pack_range(begin + 1, end)));
+
+	*index = begin;
+	return 1;
+}
+
+/* Steal the upper half of another worker's range */
+static int steal(worker_t *restrict worker, uint32_t *index)
+{
+	for (unsigned int i = 1; i < worker_num; ++i) {
+		work_range_t *victim = &ranges[(worker->id + i) % worker_num];
+		uint64_t old = atomic_load(&victim->range);
+		uint32_t begin, end, split;
+
+		do {
+			begin = (uint32_t)(old >> 32);
+			end = (uint32_t)old;
+			if (begin >= end)
+				break;
+			split = end - (end - begin + 1) / 2;
+		} while (!atomic_compare_exchange_weak(&victim->range, &old, pack_range(begin, split)));
+
+		if (begin >= end)
+			continue;
+
+		/* Keep the first stolen game, the rest becomes our own range */
+		atomic_store(&ranges[worker->id].range, pack_range(split + 1, end));
+		*index = split;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *worker_main(void *arg)
+{
+	worker_t *worker = arg;
+	uint32_t index;
+
+	while (take_own(&ranges[worker->id], &index) || steal(worker, &index))
+		play_game(worker, index);
+
+	if (pilot_ready)
+		autopilot_destory(&pilot);
+	if (mcts_ready)
+		mcts_destory(&mcts);
+
+	return NULL;
+}
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-n games] [-j threads] [-s seed] [-m max_ticks] [-S strategy,...]\n"
+		"          [-b mcts_budget_ms] [-R mcts_rollouts] [-W width] [-H height] [-w win_size]\n"
+		"Strategies: random, greedy, autopilot, mcts\n", name);
+}
+
+static int parse_strategies(char *list)
+{
+	strategy_num = 0;
+	for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+		size_t i;
+		for (i = 0; i < sizeof(known_strategies) / sizeof(known_strategies[0]); ++i) {
+			if (strcmp(name, known_strategies[i].name) == 0)
+				break;
+		}
+
+		if (i == sizeof(known_strategies) / sizeof(known_strategies[0]) ||
+				strategy_num == MAX_STRATEGIES) {
+			fprintf(stderr, "Unknown strategy: %s\n", name);
+			return 0;
+		}
+
+		strategies[strategy_num] = known_strategies[i].strategy;
+		strategy_names[strategy_num++] = known_strategies[i].name;
+	}
+
+	return strategy_num != 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long game_num = 10000;
+	char default_strategies[] = "random,greedy,autopilot";
+	char *strategy_list = default_strategies;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	worker_num = cpus > 0 ? (unsigned int)cpus : 1;
+	board = game_default_config;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:j:s:m:S:b:R:W:H:w:")) != -1) {
+		switch (opt) {
+			case 'n':
+				game_num = strtoul(optarg, NULL, 0);
+				break;
+			case 'j':
+				worker_num = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				seed_base = strtoull(optarg, NULL, 0);
+				break;
+			case 'm':
+				max_ticks = strtoul(optarg, NULL, 0);
+				break;
+			case 'S':
+				strategy_list = optarg;
+				break;
+			case 'b':
+				mcts_budget_ms = strtol(optarg, NULL, 0);
+				break;
+			case 'R':
+				mcts_rollouts = strtoul(optarg, NULL, 0);
+				break;
+			case 'W':
+				board.width = parse_side(optarg);
+				break;
+			case 'H':
+				board.height = parse_side(optarg);
+				break;
+			case 'w':
+				board.win_size = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			default:
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (game_num == 0 || game_num > UINT32_MAX || worker_num == 0 ||
+			!parse_strategies(strategy_list)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char *board_error = game_config_error(&board);
+	if (board_error != NULL) {
+		fprintf(stderr, "Invalid board: %s\n", board_error);
+		return EXIT_FAILURE;
+	}
+
+	ranges = aligned_alloc(64, sizeof(work_range_t) * worker_num);
+	workers = calloc(worker_num, sizeof(worker_t));
+	if (ranges == NULL || workers == NULL) {
+		fputs("Tournament->FATAL: Could not allocate memory!\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	/* Split the games evenly, stealing balances the rest */
+	for (unsigned int i = 0; i < worker_num; ++i) {
+		uint32_t begin = (uint32_t)(game_num * i / worker_num);
+		uint32_t end = (uint32_t)(game_num * (i + 1) / worker_num);
+		atomic_init(&ranges[i].range, pack_range(begin, end));
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (unsigned int i = 0; i < worker_num; ++i) {
+		workers[i].id = i;
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("FATAL");
+			return EXIT_FAILURE;
+		}
+	}
+	for (unsigned int i = 0; i < worker_num; ++i)
+		pthread_join(workers[i].thread, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (double)(end.tv_sec - start.tv_sec) +
+		(double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	/* Aggregate the results of all workers */
+	unsigned long long total_ticks = 0;
+	printf("%-10s %10s %9s %9s %11s %11s\n",
+		"strategy", "games", "win_rate", "timeouts", "mean_length", "mean_ticks");
+	for (unsigned int s = 0; s < strategy_num; ++s) {
+		result_t sum = { 0 };
+		for (unsigned int i = 0; i < worker_num; ++i) {
+			sum.games += workers[i].results[s].games;
+			sum.wins += workers[i].results[s].wins;
+			sum.timeouts += workers[i].results[s].timeouts;
+			sum.length_sum += workers[i].results[s].length_sum;
+			sum.ticks += workers[i].results[s].ticks;
+		}
+		total_ticks += sum.ticks;
+
+		if (sum.games == 0)
+			continue;
+		printf("%-10s %10lu %8.2f%% %9lu %11.2f %11.1f\n",
+			strategy_names[s], sum.games, 100.0 * sum.wins / sum.games, sum.timeouts,
+			(double)sum.length_sum / sum.games, (double)sum.ticks / sum.games);
+	}
+
+	printf("\n%llu ticks in %.3f s on %u threads, %.0f ticks/s\n",
+		total_ticks, seconds, worker_num, total_ticks / seconds);
+
+	free(ranges);
+	free(workers);
+
+	return EXIT_SUCCESS;
+}
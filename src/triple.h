@@ -0,0 +1,97 @@
+/* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com>
+ * Lock-free triple buffer, one writer hands whole frames to one reader.
+ * Neither side ever waits, the reader always gets the latest frame and
+ * the frames it was too slow for are skipped
+ */
+#ifndef __SNAKE_TRIPLE_H__
+#define __SNAKE_TRIPLE_H__
+
+#include "common-def.h"
+
+#include <stdatomic.h>
+
+/* Set on the middle slot while it holds a frame the reader has not taken */
+#define TRIPLE_FRESH 4U
+
+/* Triple buffer struct, every slot belongs to the writer, the reader or
+ * the middle at any time, and only the middle is shared
+ */
+typedef struct {
+	void *slots[3];
+	_Alignas(64) atomic_uint middle;
+	_Alignas(64) unsigned int write;
+	_Alignas(64) unsigned int read;
+} triple_buffer_t;
+
+/* Initialize a triple buffer
+ *
+ * Parameters:
+ * buffer: pointer to a triple buffer
+ * a, b, c: the three slots, a belongs to the writer and c to the reader
+ *
+ * Return:
+ * None
+ */
+always_inline void triple_init(triple_buffer_t *restrict buffer, void *a, void *b, void *c)
+{
+	buffer->slots[0] = a;
+	buffer->slots[1] = b;
+	buffer->slots[2] = c;
+	buffer->write = 0;
+	buffer->read = 2;
+	atomic_store_explicit(&buffer->middle, 1, memory_order_relaxed);
+}
+
+/* The slot the writer fills, writer side */
+always_inline void *triple_write_slot(const triple_buffer_t *restrict buffer)
+{
+	return buffer->slots[buffer->write];
+}
+
+/* Whether the reader took the last frame published, writer side */
+always_inline int triple_taken(const triple_buffer_t *restrict buffer)
+{
+	return !(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_FRESH);
+}
+
+/* Hand the filled slot to the reader, writer side
+ *
+ * Parameters:
+ * buffer: pointer to a triple buffer
+ *
+ * Return:
+ * 1 if the frame replaced one the reader never took, 0 otherwise
+ */
+always_inline int triple_publish(triple_buffer_t *restrict buffer)
+{
+	unsigned int old = atomic_exchange_explicit(&buffer->middle,
+		buffer->write | TRIPLE_FRESH, memory_order_acq_rel);
+	buffer->write = old & 3U;
+	return (old & TRIPLE_FRESH) != 0;
+}
+
+/* Take the latest frame if there is a new one, reader side
+ *
+ * Parameters:
+ * buffer: pointer to a triple buffer
+ *
+ * Return:
+ * 1 if triple_read_slot() now holds a new frame, 0 otherwise
+ */
+always_inline int triple_take(triple_buffer_t *restrict buffer)
+{
+	if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_FRESH))
+		return 0;
+
+	buffer->read = atomic_exchange_explicit(&buffer->middle, buffer->read,
+		memory_order_acq_rel) & 3U;
+	return 1;
+}
+
+/* The slot of the last frame taken, reader side */
+always_inline void *triple_read_slot(const triple_buffer_t *restrict buffer)
+{
+	return buffer->slots[buffer->read];
+}
+
+#endif
@@ -1,7 +1,22 @@
 /* Copyright (c) 2020, William TANG <galaxyking0419@gmail.com> */
 #include "tui.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#endif
+
 #ifdef _WIN32
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
 static CONSOLE_FONT_INFOEX cfi_old;
 
 void console_setup(void)
@@ -10,6 +25,11 @@ void console_setup(void)
 	HANDLE stdout_handle = GetStdHandle(STD_OUTPUT_HANDLE);
 	SetConsoleCursorInfo(stdout_handle, &cursor_info);
 
+	/* The screen frames are made of VT escape sequences */
+	DWORD out_mode = 0;
+	GetConsoleMode(stdout_handle, &out_mode);
+	SetConsoleMode(stdout_handle, out_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+
 	DWORD mode = 0;
 	HANDLE stdin_handle = GetStdHandle(STD_INPUT_HANDLE);
 	GetConsoleMode(stdin_handle, &mode);
@@ -57,6 +77,18 @@ void clrscr(void)
 
 	SetConsoleCursorPosition(stdout_handle, init_cord);
 }
+
+void terminal_size(short *restrict rows, short *restrict cols)
+{
+	CONSOLE_SCREEN_BUFFER_INFO csbi;
+	if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) {
+		*rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+		*cols = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+	} else {
+		*rows = TERMINAL_DEFAULT_ROWS;
+		*cols = TERMINAL_DEFAULT_COLS;
+	}
+}
 #else
 void console_setup(void)
 {
@@ -86,4 +118,240 @@ void restore_console(void)
 	tcsetattr(STDIN_FILENO, TCSANOW, &tmp_config);
 	write(STDOUT_FILENO, "\e[?25h", 6);
 }
-#endif
\ No newline at end of file
+
+void terminal_size(short *restrict rows, short *restrict cols)
+{
+	struct winsize size;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+		*rows = size.ws_row > SHRT_MAX ? SHRT_MAX : (short)size.ws_row;
+		*cols = size.ws_col > SHRT_MAX ? SHRT_MAX : (short)size.ws_col;
+	} else {
+		*rows = TERMINAL_DEFAULT_ROWS;
+		*cols = TERMINAL_DEFAULT_COLS;
+	}
+}
+#endif
+
+static const char *const attr_seq[2] = { "\e[39;49m", "\e[30;47m" };
+
+always_inline int num_len(int num)
+{
+	int len = 1;
+	while (num >= 10) {
+		num /= 10;
+		++len;
+	}
+	return len;
+}
+
+/* Escape sequence moving the cursor by num in the direction dir,
+ * the count is omitted when it is 1
+ */
+always_inline char *put_rel_move(char *out, int num, char dir)
+{
+	if (num > 1)
+		out += sprintf(out, "\e[%d%c", num, dir);
+	else {
+		memcpy(out, "\e[", 2);
+		out[2] = dir;
+		out += 3;
+	}
+	return out;
+}
+
+always_inline int rel_move_len(int num)
+{
+	return num == 0 ? 0 : num == 1 ? 3 : 3 + num_len(num);
+}
+
+/* Move the cursor with the shortest sequence available */
+static char *put_cursor_move(screen_t *restrict screen,
+							 char *out,
+							 short row,
+							 short column)
+{
+	int abs_cost = 4 + num_len(row) + num_len(column);
+
+	if (screen->cursor_row == 0) {
+		out += sprintf(out, "\e[%d;%dH", row, column);
+		return out;
+	}
+
+	int dr = row - screen->cursor_row;
+	int dc = column - screen->cursor_col;
+	int v_cost = rel_move_len(dr < 0 ? -dr : dr);
+
+	/* Horizontal options: CUF/CUB, carriage return and CUF, or reprinting
+	 * the unchanged cells in between when they share the cursor attribute
+	 */
+	int h_cost = rel_move_len(dc < 0 ? -dc : dc);
+	int cr_cost = 1 + rel_move_len(column - 1);
+	int reprint = 0;
+	if (dr == 0 && dc > 0 && dc <= h_cost) {
+		reprint = 1;
+		const screen_cell_t *cell =
+			&screen->back[(row - 1) * screen->cols + screen->cursor_col - 1];
+		for (int i = 0; i < dc; ++i)
+			reprint &= cell[i].attr == screen->cursor_attr;
+	}
+
+	if (reprint) {
+		const screen_cell_t *cell =
+			&screen->back[(row - 1) * screen->cols + screen->cursor_col - 1];
+		for (int i = 0; i < dc; ++i)
+			*out++ = cell[i].ch;
+	} else if (v_cost + (h_cost < cr_cost ? h_cost : cr_cost) < abs_cost) {
+		if (dr != 0)
+			out = put_rel_move(out, dr < 0 ? -dr : dr, dr < 0 ? 'A' : 'B');
+		if (h_cost <= cr_cost) {
+			if (dc != 0)
+				out = put_rel_move(out, dc < 0 ? -dc : dc, dc < 0 ? 'D' : 'C');
+		} else {
+			*out++ = '\r';
+			if (column > 1)
+				out = put_rel_move(out, column - 1, 'C');
+		}
+	} else {
+		out += sprintf(out, "\e[%d;%dH", row, column);
+	}
+
+	return out;
+}
+
+void screen_init_shared(screen_t *restrict screen, short rows, short cols,
+	char *restrict out)
+{
+	size_t cells = (size_t)rows * cols;
+
+	screen->front = (screen_cell_t *)malloc(cells * sizeof(screen_cell_t));
+	screen->back = (screen_cell_t *)malloc(cells * sizeof(screen_cell_t));
+	if (screen->front == NULL || screen->back == NULL) {
+		fputs("Screen->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+
+	screen->out = out;
+	screen->owns_out = 0;
+	screen->rows = rows;
+	screen->cols = cols;
+	screen->attr = ATTR_NORMAL;
+
+	screen_reset(screen);
+}
+
+void screen_init(screen_t *restrict screen, short rows, short cols)
+{
+	char *out = (char *)malloc(SCREEN_OUT_SIZE(rows, cols));
+	if (out == NULL) {
+		fputs("Screen->FATAL: Could not allocate memory!\n", stderr);
+		exit(1);
+	}
+
+	screen_init_shared(screen, rows, cols, out);
+	screen->owns_out = 1;
+}
+
+void screen_reset(screen_t *restrict screen)
+{
+	size_t cells = (size_t)screen->rows * screen->cols;
+
+	for (size_t i = 0; i < cells; ++i)
+		screen->front[i] = (screen_cell_t){ ' ', ATTR_NORMAL };
+	memcpy(screen->back, screen->front, cells * sizeof(screen_cell_t));
+
+	screen->cursor_row = 0;
+	screen->cursor_col = 0;
+	screen->cursor_attr = ATTR_NORMAL;
+}
+
+void screen_clear(screen_t *restrict screen)
+{
+	size_t cells = (size_t)screen->rows * screen->cols;
+
+	for (size_t i = 0; i < cells; ++i)
+		screen->back[i] = (screen_cell_t){ ' ', ATTR_NORMAL };
+}
+
+void screen_puts(screen_t *restrict screen,
+				 short row,
+				 short column,
+				 const char *restrict str)
+{
+	for (; *str != '\0' && column <= screen->cols; ++str, ++column)
+		screen_put(screen, row, column, *str);
+}
+
+size_t screen_render(screen_t *restrict screen)
+{
+	char *out = screen->out;
+
+	for (short row = 1; row <= screen->rows; ++row) {
+		screen_cell_t *front = &screen->front[(row - 1) * screen->cols];
+		screen_cell_t *back = &screen->back[(row - 1) * screen->cols];
+
+		for (short column = 1; column <= screen->cols; ++column) {
+			screen_cell_t *cell = &back[column - 1];
+			if (memcmp(cell, &front[column - 1], sizeof(screen_cell_t)) == 0)
+				continue;
+
+			if (screen->cursor_row != row || screen->cursor_col != column)
+				out = put_cursor_move(screen, out, row, column);
+
+			if (cell->attr != screen->cursor_attr) {
+				out += sprintf(out, "%s", attr_seq[cell->attr]);
+				screen->cursor_attr = cell->attr;
+			}
+
+			*out++ = cell->ch;
+			front[column - 1] = *cell;
+
+			/* The cursor may wait for a wrap at the last column */
+			screen->cursor_row = column == screen->cols ? 0 : row;
+			screen->cursor_col = column + 1;
+		}
+	}
+
+	/* Leave the terminal with normal attributes for anything else printed */
+	if (screen->cursor_attr != ATTR_NORMAL) {
+		out += sprintf(out, "%s", attr_seq[ATTR_NORMAL]);
+		screen->cursor_attr = ATTR_NORMAL;
+	}
+
+	return (size_t)(out - screen->out);
+}
+
+void screen_flush(screen_t *restrict screen)
+{
+	size_t len = screen_render(screen);
+	if (len == 0)
+		return;
+
+#ifdef _WIN32
+	DWORD written;
+	WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), screen->out, (DWORD)len, &written, NULL);
+#else
+	/* Only a full terminal buffer splits the frame into more writes, the front
+	 * buffer already holds the whole frame, so none of it may be dropped
+	 */
+	for (size_t sent = 0; sent < len;) {
+		ssize_t ret = write(STDOUT_FILENO, screen->out + sent, len - sent);
+		if (ret > 0) {
+			sent += (size_t)ret;
+		} else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			/* Someone else made the terminal non blocking, wait until it drains */
+			struct pollfd out = { STDOUT_FILENO, POLLOUT, 0 };
+			poll(&out, 1, -1);
+		} else if (ret == 0 || errno != EINTR) {
+			break;
+		}
+	}
+#endif
+}
+
+void screen_destory(screen_t *restrict screen)
+{
+	free(screen->front);
+	free(screen->back);
+	if (screen->owns_out)
+		free(screen->out);
+}
@@ -9,6 +9,47 @@
 
 #include "common-def.h"
 
+#include <stddef.h>
+
+/* Size assumed when the terminal does not tell its own */
+#define TERMINAL_DEFAULT_ROWS 24
+#define TERMINAL_DEFAULT_COLS 80
+
+/* Worst case bytes per cell of a frame: a cursor move, an attribute change and the character */
+#define SCREEN_CELL_BYTES 24
+/* Size of the frame buffer of a screen */
+#define SCREEN_OUT_SIZE(rows, cols) ((size_t)(rows) * (size_t)(cols) * SCREEN_CELL_BYTES + 16)
+
+/* Attributes of a screen cell */
+enum { ATTR_NORMAL, ATTR_HIGHLIGHT };
+
+/* Screen cell struct */
+typedef struct {
+	char ch;
+	unsigned char attr;
+} screen_cell_t;
+
+/* Double buffered screen
+ *
+ * Drawing only touches the back buffer, a flush diffs it against the front
+ * buffer (what the terminal shows) and sends the changes in a single write
+ */
+typedef struct {
+	short rows;
+	short cols;
+	/* Cursor position on the terminal, row 0 if it is unknown */
+	short cursor_row;
+	short cursor_col;
+	unsigned char cursor_attr;
+	/* Attribute of the cells put next */
+	unsigned char attr;
+	/* Whether out is freed with the screen */
+	unsigned char owns_out;
+	screen_cell_t *front;
+	screen_cell_t *back;
+	char *out;
+} screen_t;
+
 #ifdef _WIN32
 #include <windows.h>
 
@@ -71,4 +112,150 @@ always_inline void cancel_highlight(void)
 }
 #endif
 
-#endif
\ No newline at end of file
+/* Get the size of the terminal
+ *
+ * Parameters:
+ * rows: where to put the number of rows
+ * cols: where to put the number of columns
+ *
+ * Return:
+ * None
+ *
+ * Note: 24x80 if it is not a terminal
+ */
+extern void terminal_size(short *restrict rows, short *restrict cols);
+
+/* Initialize a screen, the terminal is assumed to be cleared
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * rows: number of rows of the screen
+ * cols: number of columns of the screen
+ *
+ * Return:
+ * None
+ */
+extern void screen_init(screen_t *restrict screen, short rows, short cols);
+
+/* Initialize a screen which renders into a buffer shared with other screens
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * rows: number of rows of the screen
+ * cols: number of columns of the screen
+ * out: a buffer of at least SCREEN_OUT_SIZE(rows, cols) bytes
+ *
+ * Return:
+ * None
+ *
+ * Note: Only the two cell buffers belong to the screen, so many screens
+ *	   rendered one at a time cost 4 bytes per cell each
+ */
+extern void screen_init_shared(screen_t *restrict screen, short rows, short cols,
+	char *restrict out);
+
+/* Tell the screen that the terminal has been cleared
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ *
+ * Return:
+ * None
+ */
+extern void screen_reset(screen_t *restrict screen);
+
+/* Blank the back buffer
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ *
+ * Return:
+ * None
+ */
+extern void screen_clear(screen_t *restrict screen);
+
+/* Put a character on the back buffer, rows and columns start from 1
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * row: row of the character
+ * column: column of the character
+ * ch: the character
+ *
+ * Return:
+ * None
+ */
+always_inline void screen_put(screen_t *restrict screen,
+							  short row,
+							  short column,
+							  char ch)
+{
+	if (row < 1 || row > screen->rows || column < 1 || column > screen->cols)
+		return;
+
+	screen_cell_t *cell = &screen->back[(row - 1) * screen->cols + column - 1];
+	cell->ch = ch;
+	cell->attr = screen->attr;
+}
+
+/* Put a string on the back buffer, it is clipped at the right edge
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ * row: row of the first character
+ * column: column of the first character
+ * str: the string
+ *
+ * Return:
+ * None
+ */
+extern void screen_puts(screen_t *restrict screen,
+						short row,
+						short column,
+						const char *restrict str);
+
+always_inline void screen_highlight(screen_t *restrict screen)
+{
+	screen->attr = ATTR_HIGHLIGHT;
+}
+
+always_inline void screen_cancel_highlight(screen_t *restrict screen)
+{
+	screen->attr = ATTR_NORMAL;
+}
+
+/* Encode the difference between the back and the front buffer
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ *
+ * Return:
+ * The number of bytes written to screen->out
+ *
+ * Note: The front buffer is updated as if the bytes were sent
+ */
+extern size_t screen_render(screen_t *restrict screen);
+
+/* Send the changes of the back buffer to the terminal in one write
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ *
+ * Return:
+ * None
+ */
+extern void screen_flush(screen_t *restrict screen);
+
+/* Destory a screen
+ *
+ * Parameters:
+ * screen: pointer to a screen
+ *
+ * Return:
+ * None
+ *
+ * Note: ALWAYS call it to prevent memory leak
+ */
+extern void screen_destory(screen_t *restrict screen);
+
+#endif